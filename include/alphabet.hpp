@@ -0,0 +1,152 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Shen-Ta Hsieh
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <span>
+#include <vector>
+
+// dense symbol ids of a dataset, ordered like the code points they stand for
+// so sorted words stay sorted after encoding
+class Alphabet {
+public:
+  using symbol_type = uint8_t;
+  template <std::size_t kSize> using word_type = std::array<symbol_type, kSize>;
+
+  // id of symbols outside the alphabet, never equal to a dataset symbol
+  static inline constexpr const symbol_type kUnknown = UINT8_MAX;
+
+  template <std::size_t kSize>
+  static inline std::optional<Alphabet>
+  build(std::initializer_list<std::span<const std::array<char32_t, kSize>>>
+            lists) noexcept {
+    // code points of the basic multilingual plane are marked in a bitmap,
+    // rarer ones are kept sorted as they come
+    std::vector<uint64_t> seen(kTableLimit / 64);
+    std::vector<char32_t> rare;
+    for (const auto &list : lists) {
+      for (const auto &word : list) {
+        for (const auto char_ : word) {
+          if (char_ < kTableLimit) {
+            seen[char_ / 64] |= UINT64_C(1) << (char_ % 64);
+            continue;
+          }
+          const auto it = std::lower_bound(rare.begin(), rare.end(), char_);
+          if (it == rare.end() || *it != char_) {
+            rare.insert(it, char_);
+          }
+        }
+      }
+    }
+
+    Alphabet alphabet;
+    auto &symbols = alphabet.symbols;
+    for (size_t block = 0; block < seen.size(); ++block) {
+      for (uint64_t bits = seen[block]; bits; bits &= bits - 1) {
+        symbols.push_back(
+            static_cast<char32_t>(block * 64 + std::countr_zero(bits)));
+      }
+    }
+    symbols.insert(symbols.end(), rare.begin(), rare.end());
+    if (symbols.size() >= kUnknown) {
+      return std::nullopt;
+    }
+    symbols.shrink_to_fit();
+    return alphabet;
+  }
+
+  symbol_type encode(char32_t char_) const noexcept {
+    const auto it = std::lower_bound(symbols.begin(), symbols.end(), char_);
+    if (it == symbols.end() || *it != char_) {
+      return kUnknown;
+    }
+    return static_cast<symbol_type>(std::distance(symbols.begin(), it));
+  }
+
+  char32_t decode(symbol_type symbol) const noexcept {
+    if (symbol >= symbols.size()) {
+      return U'?';
+    }
+    return symbols[symbol];
+  }
+
+  template <std::size_t kSize>
+  word_type<kSize>
+  encode(std::span<const char32_t, kSize> word) const noexcept {
+    word_type<kSize> result;
+    std::transform(word.begin(), word.end(), result.begin(),
+                   [this](char32_t char_) noexcept { return encode(char_); });
+    return result;
+  }
+
+  template <std::size_t kSize>
+  std::vector<word_type<kSize>>
+  encode(std::span<const std::array<char32_t, kSize>> words) const noexcept {
+    const Encoder encoder(*this);
+    std::vector<word_type<kSize>> result(words.size());
+    std::transform(words.begin(), words.end(), result.begin(),
+                   [&encoder](const auto &word) noexcept {
+                     return encoder.encode<kSize>(word);
+                   });
+    return result;
+  }
+
+  // encodes many words of an alphabet through a table indexed by code point
+  // when its symbols are all in the basic multilingual plane
+  class Encoder {
+  public:
+    explicit Encoder(const Alphabet &alphabet) noexcept : alphabet(alphabet) {
+      if (alphabet.symbols.empty() || alphabet.symbols.back() >= kTableLimit) {
+        return;
+      }
+      table.assign(alphabet.symbols.back() + 1, kUnknown);
+      for (size_t symbol = 0; symbol < alphabet.symbols.size(); ++symbol) {
+        table[alphabet.symbols[symbol]] = static_cast<symbol_type>(symbol);
+      }
+    }
+
+    symbol_type encode(char32_t char_) const noexcept {
+      if (table.empty()) {
+        return alphabet.encode(char_);
+      }
+      return char_ < table.size() ? table[char_] : kUnknown;
+    }
+
+    template <std::size_t kSize>
+    word_type<kSize>
+    encode(std::span<const char32_t, kSize> word) const noexcept {
+      word_type<kSize> result;
+      std::transform(word.begin(), word.end(), result.begin(),
+                     [this](char32_t char_) noexcept { return encode(char_); });
+      return result;
+    }
+
+  private:
+    const Alphabet &alphabet;
+    std::vector<symbol_type> table;
+  };
+
+  template <std::size_t kSize>
+  std::array<char32_t, kSize>
+  decode(std::span<const symbol_type, kSize> word) const noexcept {
+    std::array<char32_t, kSize> result;
+    std::transform(word.begin(), word.end(), result.begin(),
+                   [this](symbol_type symbol) noexcept {
+                     return decode(symbol);
+                   });
+    return result;
+  }
+
+  std::vector<char32_t> symbols;
+
+private:
+  // code points below it are looked up in tables while building and
+  // encoding, the basic multilingual plane
+  static inline constexpr const char32_t kTableLimit = 0x10000;
+};
@@ -0,0 +1,266 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Shen-Ta Hsieh
+
+#pragma once
+
+#include "pattern.hpp"
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <initializer_list>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Cache {
+
+using std::literals::string_view_literals::operator""sv;
+static inline constexpr const auto kDirectory = "wordle_solver"sv;
+static inline constexpr const std::array<char, 8> kMagic{'W', 'O', 'R', 'D',
+                                                         'L', 'E', 'P', 'M'};
+static inline constexpr const uint32_t kVersion = 2;
+
+struct Header {
+  std::array<char, 8> magic;
+  uint32_t version;
+  uint32_t size;
+  uint32_t pattern_bytes;
+  uint32_t symbol_count;
+  uint64_t dataset_hash;
+  uint64_t guess_count;
+  uint64_t answer_count;
+  uint64_t checksum;
+};
+
+static inline constexpr uint64_t aligned(uint64_t offset) noexcept {
+  return (offset + sizeof(uint64_t) - 1) / sizeof(uint64_t) * sizeof(uint64_t);
+}
+
+static inline constexpr const uint64_t kChecksumBasis =
+    UINT64_C(0xcbf29ce484222325);
+
+// fnv-1a over 64 bit lanes, chain calls by passing the previous result
+static inline constexpr uint64_t
+checksum(std::span<const std::byte> data,
+         uint64_t result = kChecksumBasis) noexcept {
+  constexpr const uint64_t kPrime = UINT64_C(0x100000001b3);
+  size_t index = 0;
+  for (; index + sizeof(uint64_t) <= data.size(); index += sizeof(uint64_t)) {
+    uint64_t value = 0;
+    for (size_t byte = 0; byte < sizeof(uint64_t); ++byte) {
+      value |= static_cast<uint64_t>(data[index + byte]) << (byte * 8);
+    }
+    result = (result ^ value) * kPrime;
+    result ^= result >> 29;
+  }
+  for (; index < data.size(); ++index) {
+    result = (result ^ static_cast<uint64_t>(data[index])) * kPrime;
+  }
+  return result;
+}
+
+template <std::size_t kSize>
+static inline uint64_t
+checksum(const Pattern::Matrix<kSize> &matrix) noexcept {
+  uint64_t result = checksum(std::as_bytes(std::span(matrix.alphabet.symbols)));
+  result = checksum(std::as_bytes(matrix.guesses), result);
+  result = checksum(std::as_bytes(matrix.answers), result);
+  return checksum(std::as_bytes(matrix.patterns), result);
+}
+
+// content hash of the dataset files the cache was built from
+template <std::size_t kSize>
+static inline std::optional<uint64_t>
+hash(std::initializer_list<std::filesystem::path> filenames) noexcept {
+  const std::array<uint32_t, 2> key{kVersion, kSize};
+  uint64_t result = checksum(std::as_bytes(std::span(key)));
+  for (const auto &filename : filenames) {
+    std::ifstream file(filename, std::ios::binary);
+    if (!file) {
+      return std::nullopt;
+    }
+    std::string content{std::istreambuf_iterator<char>(file),
+                        std::istreambuf_iterator<char>()};
+    result = checksum(std::as_bytes(std::span(content)), result);
+  }
+  return result;
+}
+
+static inline std::optional<std::filesystem::path> directory() noexcept {
+#ifdef __EMSCRIPTEN__
+  return std::nullopt;
+#else
+  if (const char *cache_home = std::getenv("XDG_CACHE_HOME");
+      cache_home && *cache_home) {
+    return std::filesystem::path(cache_home) / kDirectory;
+  }
+  if (const char *home = std::getenv("HOME"); home && *home) {
+    return std::filesystem::path(home) / ".cache" / kDirectory;
+  }
+  std::error_code error;
+  auto temp = std::filesystem::temp_directory_path(error);
+  if (error) {
+    return std::nullopt;
+  }
+  return temp / kDirectory;
+#endif
+}
+
+template <std::size_t kSize>
+static inline std::optional<std::filesystem::path>
+filename(uint64_t dataset_hash, std::string_view kind = "pattern"sv) noexcept {
+  auto path = directory();
+  if (!path) {
+    return std::nullopt;
+  }
+  std::array<char, 16> hex;
+  const auto [last, error] = std::to_chars(hex.begin(), hex.end(),
+                                           dataset_hash, 16);
+  std::string name(kind);
+  name += "-" + std::to_string(kSize) + "-";
+  name.append(hex.size() - std::distance(hex.begin(), last), '0');
+  name.append(hex.begin(), last);
+  name += ".bin";
+  return *path / name;
+}
+
+// write parts to filename through a temporary file, so readers never see a
+// partial file
+static inline bool
+replace(const std::filesystem::path &filename,
+        std::initializer_list<std::span<const std::byte>> parts) noexcept {
+  std::error_code error;
+  std::filesystem::create_directories(filename.parent_path(), error);
+  if (error) {
+    return false;
+  }
+
+  auto temporary = filename;
+  temporary += ".tmp" + std::to_string(::getpid());
+  {
+    std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+    for (const auto bytes : parts) {
+      file.write(reinterpret_cast<const char *>(bytes.data()), bytes.size());
+    }
+    if (!file) {
+      file.close();
+      std::filesystem::remove(temporary, error);
+      return false;
+    }
+  }
+  std::filesystem::rename(temporary, filename, error);
+  if (error) {
+    std::filesystem::remove(temporary, error);
+    return false;
+  }
+  return true;
+}
+
+// map a cache file, nullptr when missing, stale or corrupt
+template <std::size_t kSize>
+static inline std::shared_ptr<const Pattern::Matrix<kSize>>
+open(const std::filesystem::path &filename, uint64_t dataset_hash) noexcept {
+  using Matrix = Pattern::Matrix<kSize>;
+  using word_type = typename Matrix::word_type;
+  using pattern_type = typename Matrix::pattern_type;
+
+  const int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat status;
+  if (::fstat(fd, &status) != 0 ||
+      static_cast<uint64_t>(status.st_size) < sizeof(Header)) {
+    ::close(fd);
+    return nullptr;
+  }
+  const auto length = static_cast<size_t>(status.st_size);
+  void *address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (address == MAP_FAILED) {
+    return nullptr;
+  }
+  std::shared_ptr<const void> mapping(address, [length](const void *address) {
+    ::munmap(const_cast<void *>(address), length);
+  });
+
+  const auto *base = static_cast<const std::byte *>(address);
+  Header header;
+  std::memcpy(&header, base, sizeof(Header));
+  if (header.magic != kMagic || header.version != kVersion ||
+      header.size != kSize || header.pattern_bytes != sizeof(pattern_type) ||
+      header.dataset_hash != dataset_hash ||
+      header.symbol_count >= Alphabet::kUnknown ||
+      header.guess_count > UINT32_MAX || header.answer_count > UINT32_MAX) {
+    return nullptr;
+  }
+  const uint64_t symbols_length = header.symbol_count * sizeof(char32_t);
+  const uint64_t words_length =
+      (header.guess_count + header.answer_count) * sizeof(word_type);
+  const uint64_t patterns_offset =
+      aligned(sizeof(Header) + symbols_length + words_length);
+  const uint64_t patterns_length =
+      Matrix::memory_usage(header.guess_count, header.answer_count);
+  if (patterns_offset + patterns_length != length) {
+    return nullptr;
+  }
+
+  auto matrix = std::make_shared<Matrix>();
+  const auto *symbols =
+      reinterpret_cast<const char32_t *>(base + sizeof(Header));
+  matrix->alphabet.symbols.assign(symbols, symbols + header.symbol_count);
+  const auto *words = reinterpret_cast<const word_type *>(
+      base + sizeof(Header) + symbols_length);
+  matrix->guesses = {words, header.guess_count};
+  matrix->answers = {words + header.guess_count, header.answer_count};
+  matrix->patterns = {
+      reinterpret_cast<const pattern_type *>(base + patterns_offset),
+      header.guess_count * header.answer_count};
+  if (checksum(*matrix) != header.checksum) {
+    return nullptr;
+  }
+  matrix->storage = std::move(mapping);
+  return matrix;
+}
+
+template <std::size_t kSize>
+static inline bool save(const std::filesystem::path &filename,
+                        uint64_t dataset_hash,
+                        const Pattern::Matrix<kSize> &matrix) noexcept {
+  using pattern_type = typename Pattern::Matrix<kSize>::pattern_type;
+
+  Header header{};
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.size = kSize;
+  header.pattern_bytes = sizeof(pattern_type);
+  header.symbol_count = matrix.alphabet.symbols.size();
+  header.dataset_hash = dataset_hash;
+  header.guess_count = matrix.guesses.size();
+  header.answer_count = matrix.answers.size();
+  header.checksum = checksum(matrix);
+
+  const auto symbols = std::as_bytes(std::span(matrix.alphabet.symbols));
+  const auto guesses = std::as_bytes(matrix.guesses);
+  const auto answers = std::as_bytes(matrix.answers);
+  const uint64_t offset =
+      sizeof(Header) + symbols.size() + guesses.size() + answers.size();
+  // words are bytes, pad so the patterns are aligned in the mapping
+  const std::array<std::byte, sizeof(uint64_t)> padding{};
+  return replace(filename, {std::as_bytes(std::span(&header, 1)), symbols,
+                            guesses, answers,
+                            std::span(padding).first(aligned(offset) - offset),
+                            std::as_bytes(matrix.patterns)});
+}
+
+} // namespace Cache
@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Shen-Ta Hsieh
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// a bounded map from 64 bit fingerprints to values, shared between threads
+//
+// keys are spread over shards with a lock each. a full shard evicts with the
+// clock algorithm: entries read since the hand last passed them get a second
+// chance, so sets that keep coming back stay while one-off sets go first
+template <typename Value> class ClockCache {
+public:
+  static inline constexpr const std::size_t kDefaultCapacity = 1 << 16;
+
+  explicit ClockCache(std::size_t capacity = kDefaultCapacity) noexcept
+      : shards(std::bit_ceil(std::clamp<std::size_t>(capacity / kShardSize, 1,
+                                                     kMaxShards))) {
+    const std::size_t per_shard =
+        std::max<std::size_t>((capacity + shards.size() - 1) / shards.size(),
+                              1);
+    for (auto &shard : shards) {
+      shard.capacity = per_shard;
+    }
+  }
+
+  ClockCache(const ClockCache &) = delete;
+  ClockCache &operator=(const ClockCache &) = delete;
+
+  std::optional<Value> find(uint64_t key) noexcept {
+    auto &shard = shard_of(key);
+    {
+      const std::lock_guard lock(shard.mutex);
+      if (const auto it = shard.slots.find(key); it != shard.slots.end()) {
+        auto &entry = shard.entries[it->second];
+        entry.referenced = true;
+        hit_count.fetch_add(1, std::memory_order_relaxed);
+        return entry.value;
+      }
+    }
+    miss_count.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+  }
+
+  // keeps the value already stored under key, if any
+  void insert(uint64_t key, const Value &value) noexcept {
+    auto &shard = shard_of(key);
+    const std::lock_guard lock(shard.mutex);
+    if (shard.slots.contains(key)) {
+      return;
+    }
+    if (shard.entries.size() < shard.capacity) {
+      shard.slots.emplace(key, shard.entries.size());
+      shard.entries.push_back({key, value, false});
+      return;
+    }
+    while (shard.entries[shard.hand].referenced) {
+      shard.entries[shard.hand].referenced = false;
+      shard.hand = (shard.hand + 1) % shard.entries.size();
+    }
+    auto &victim = shard.entries[shard.hand];
+    shard.slots.erase(victim.key);
+    shard.slots.emplace(key, shard.hand);
+    victim = {key, value, false};
+    shard.hand = (shard.hand + 1) % shard.entries.size();
+    eviction_count.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  void clear() noexcept {
+    for (auto &shard : shards) {
+      const std::lock_guard lock(shard.mutex);
+      shard.slots.clear();
+      shard.entries.clear();
+      shard.hand = 0;
+    }
+  }
+
+  std::size_t size() const noexcept {
+    std::size_t result = 0;
+    for (auto &shard : shards) {
+      const std::lock_guard lock(shard.mutex);
+      result += shard.entries.size();
+    }
+    return result;
+  }
+
+  std::size_t capacity() const noexcept {
+    return shards.size() * shards.front().capacity;
+  }
+
+  uint64_t hits() const noexcept {
+    return hit_count.load(std::memory_order_relaxed);
+  }
+  uint64_t misses() const noexcept {
+    return miss_count.load(std::memory_order_relaxed);
+  }
+  uint64_t evictions() const noexcept {
+    return eviction_count.load(std::memory_order_relaxed);
+  }
+
+private:
+  // entries a shard should hold before the keys are spread further
+  static inline constexpr const std::size_t kShardSize = 256;
+  static inline constexpr const std::size_t kMaxShards = 64;
+
+  struct Entry {
+    uint64_t key;
+    Value value;
+    bool referenced;
+  };
+
+  struct Shard {
+    mutable std::mutex mutex;
+    std::unordered_map<uint64_t, std::size_t> slots;
+    std::vector<Entry> entries;
+    std::size_t hand = 0;
+    std::size_t capacity = 0;
+  };
+
+  Shard &shard_of(uint64_t key) noexcept {
+    // the high bits, the low ones pick the bucket inside the shard
+    return shards[(key >> 32) & (shards.size() - 1)];
+  }
+
+  std::vector<Shard> shards;
+  std::atomic<uint64_t> hit_count = 0;
+  std::atomic<uint64_t> miss_count = 0;
+  std::atomic<uint64_t> eviction_count = 0;
+};
@@ -3,145 +3,1052 @@
 
 #pragma once
 
+#include "alphabet.hpp"
+#include "clock_cache.hpp"
+#include "pattern.hpp"
+#include "progress.hpp"
+#include "score.hpp"
+#include "word_list.hpp"
 #include <algorithm>
+#include <atomic>
+#include <bit>
 #include <cstdint>
-#include <execution>
+#include <functional>
+#include <memory>
 #include <numeric>
+#include <optional>
 #include <span>
 #include <string_view>
+#include <tbb/blocked_range.h>
+#include <tbb/enumerable_thread_specific.h>
+#include <tbb/parallel_for.h>
 #include <vector>
 
 template <std::size_t kSize> class Context {
 public:
+  using symbol_type = Alphabet::symbol_type;
+  using word_type = Alphabet::word_type<kSize>;
+
   bool is_finished() const noexcept { return possible_answer.size() <= 1; }
 
-  void reorder_all_word_set() noexcept {
-    std::vector<std::array<char32_t, kSize>> union_(possible_answer.size() +
-                                                    valid_input.size());
-    const auto last = std::set_union(
-        std::execution::par_unseq, valid_input.begin(), valid_input.end(),
-        possible_answer.begin(), possible_answer.end(), union_.begin());
-    union_.erase(last, union_.end());
-    union_.shrink_to_fit();
-    std::swap(valid_input, union_);
+  bool build_pattern_matrix(
+      uint64_t memory_limit = Pattern::kMatrixMemoryLimit) noexcept;
+
+  using Best = std::tuple<double, std::span<const symbol_type, kSize>>;
+
+  // best guess and its Policy::value(), ties go to the first valid input
+  template <typename Policy = Score::Excluded>
+  inline Best find_best_candidate() const noexcept {
+    return *best_candidate<Policy>(nullptr);
+  }
+
+  // same while reporting to progress, std::nullopt once it is cancelled
+  template <typename Policy = Score::Excluded>
+  inline std::optional<Best>
+  find_best_candidate(Progress &progress) const noexcept {
+    return best_candidate<Policy>(&progress);
+  }
+
+  inline Best find_best_candidate(Score::Metric metric) const noexcept {
+    return Score::visit(metric, [this]<typename Policy>(
+                                    std::type_identity<Policy>) noexcept {
+      return find_best_candidate<Policy>();
+    });
+  }
+
+  inline std::optional<Best>
+  find_best_candidate(Score::Metric metric,
+                      Progress &progress) const noexcept {
+    return Score::visit(metric, [this, &progress]<typename Policy>(
+                                    std::type_identity<Policy>) noexcept {
+      return find_best_candidate<Policy>(progress);
+    });
+  }
+
+  struct Candidate {
+    double score;
+    std::span<const symbol_type, kSize> word;
+    // whether the guess is one of the possible answers
+    bool possible;
+    // sizes of the buckets the guess splits the possible answers into,
+    // largest first
+    std::vector<uint32_t> buckets;
+  };
+
+  // the count best guesses ranked by Policy, best first, ties go to the
+  // first valid input
+  template <typename Policy = Score::Excluded>
+  inline std::vector<Candidate>
+  find_top_candidates(std::size_t count) const noexcept {
+    return *top_candidates<Policy>(count, nullptr);
+  }
+
+  template <typename Policy = Score::Excluded>
+  inline std::optional<std::vector<Candidate>>
+  find_top_candidates(std::size_t count, Progress &progress) const noexcept {
+    return top_candidates<Policy>(count, &progress);
+  }
+
+  inline std::vector<Candidate>
+  find_top_candidates(std::size_t count, Score::Metric metric) const noexcept {
+    return Score::visit(metric, [this, count]<typename Policy>(
+                                    std::type_identity<Policy>) noexcept {
+      return find_top_candidates<Policy>(count);
+    });
+  }
+
+  inline std::optional<std::vector<Candidate>>
+  find_top_candidates(std::size_t count, Score::Metric metric,
+                      Progress &progress) const noexcept {
+    return Score::visit(metric, [this, count, &progress]<typename Policy>(
+                                    std::type_identity<Policy>) noexcept {
+      return find_top_candidates<Policy>(count, progress);
+    });
+  }
+
+  // expected guess counts of answer sets already searched, keyed by a
+  // fingerprint of the set, the valid inputs and the depth. share one
+  // between searches of the same Policy and width to reuse subproblems
+  using Memo = ClockCache<double>;
+
+  // guess with the fewest expected guesses to finish, looking depth guesses
+  // ahead over the width best guesses of Policy at every step. the value is
+  // that expected count, smaller is better
+  template <typename Policy = Score::Excluded>
+  inline Best find_lookahead_candidate(std::size_t depth, std::size_t width,
+                                       Memo *memo = nullptr) const noexcept {
+    return *lookahead_candidate<Policy>(depth, width, memo, nullptr);
+  }
+
+  template <typename Policy = Score::Excluded>
+  inline std::optional<Best>
+  find_lookahead_candidate(std::size_t depth, std::size_t width,
+                           Progress &progress,
+                           Memo *memo = nullptr) const noexcept {
+    return lookahead_candidate<Policy>(depth, width, memo, &progress);
   }
 
-  inline std::tuple<double, std::span<const char32_t, kSize>>
-  find_best_candidate() const noexcept;
+  inline Best find_lookahead_candidate(std::size_t depth, std::size_t width,
+                                       Score::Metric metric,
+                                       Memo *memo = nullptr) const noexcept {
+    return Score::visit(metric, [this, depth, width, memo]<typename Policy>(
+                                    std::type_identity<Policy>) noexcept {
+      return find_lookahead_candidate<Policy>(depth, width, memo);
+    });
+  }
+
+  inline std::optional<Best>
+  find_lookahead_candidate(std::size_t depth, std::size_t width,
+                           Score::Metric metric, Progress &progress,
+                           Memo *memo = nullptr) const noexcept {
+    return Score::visit(
+        metric, [this, depth, width, &progress, memo]<typename Policy>(
+                    std::type_identity<Policy>) noexcept {
+          return find_lookahead_candidate<Policy>(depth, width, progress,
+                                                  memo);
+        });
+  }
 
+  // filters the words by the result of candidate, returns the removed and
+  // remained answer counts
   inline std::tuple<uint64_t, uint64_t>
-  input_candidate(std::span<const char32_t, kSize> candidate,
+  input_candidate(std::span<const symbol_type, kSize> candidate,
                   std::span<const char8_t, kSize> result,
-                  bool hard_mode) noexcept;
+                  bool hard_mode) noexcept {
+    return *filter_candidate(candidate, result, hard_mode, nullptr);
+  }
+
+  // same while reporting to progress, std::nullopt and nothing filtered once
+  // it is cancelled
+  inline std::optional<std::tuple<uint64_t, uint64_t>>
+  input_candidate(std::span<const symbol_type, kSize> candidate,
+                  std::span<const char8_t, kSize> result, bool hard_mode,
+                  Progress &progress) noexcept {
+    return filter_candidate(candidate, result, hard_mode, &progress);
+  }
 
   static inline constexpr std::array<char8_t, kSize>
-  calculate(std::span<const char32_t, kSize> word,
-            std::span<const char32_t, kSize> problem) noexcept;
+  calculate(std::span<const symbol_type, kSize> word,
+            std::span<const symbol_type, kSize> problem) noexcept;
+
+  // packed patterns of the possible answers against candidate, read from the
+  // pattern matrix when it holds candidate
+  inline std::vector<Pattern::type<kSize>>
+  answer_patterns(std::span<const symbol_type, kSize> candidate,
+                  Progress *progress = nullptr) const noexcept {
+    std::optional<uint32_t> guess;
+    if (use_matrix()) {
+      guess = pattern_matrix->guess_index(candidate);
+    }
+    if (!guess) {
+      return patterns_of(candidate, possible_answer, progress);
+    }
+    const auto row = pattern_matrix->row(*guess);
+    const auto answers = possible_answer.indexes();
+    std::vector<Pattern::type<kSize>> patterns(answers.size());
+    std::transform(answers.begin(), answers.end(), patterns.begin(),
+                   [&row](uint32_t answer) noexcept { return row[answer]; });
+    if (progress) {
+      progress->advance(answers.size());
+    }
+    return patterns;
+  }
+
+  // best guess of an answer set, guess indexes the valid_input words
+  struct Solved {
+    double value;
+    uint32_t guess;
+  };
+  using SolvedCache = ClockCache<Solved>;
 
   static inline constexpr const auto size = kSize;
-  std::vector<std::array<char32_t, kSize>> possible_answer;
-  std::vector<std::array<char32_t, kSize>> valid_input;
+  Alphabet alphabet;
+  WordList<kSize> possible_answer;
+  WordList<kSize> valid_input;
+  // rows and columns are the words of valid_input and possible_answer, so
+  // their indexes are matrix indexes too
+  std::shared_ptr<const Pattern::Matrix<kSize>> pattern_matrix;
+  // when set, find_best_candidate looks the answer set up here before
+  // scoring, keyed by its fingerprint, the valid inputs left by hard mode and
+  // the metric. copies of the context share it
+  std::shared_ptr<SolvedCache> solved_cache;
+
+  // filter state of a game, taken and restored in O(1) since the word lists
+  // share their indexes
+  struct Snapshot {
+    WordList<kSize> possible_answer;
+    WordList<kSize> valid_input;
+  };
+
+  Snapshot snapshot() const noexcept { return {possible_answer, valid_input}; }
+
+  void restore(Snapshot snapshot) noexcept {
+    possible_answer = std::move(snapshot.possible_answer);
+    valid_input = std::move(snapshot.valid_input);
+  }
+
+  void use_pattern_matrix(
+      std::shared_ptr<const Pattern::Matrix<kSize>> matrix) noexcept {
+    alphabet = matrix->alphabet;
+    possible_answer = WordList<kSize>(matrix->answers, matrix);
+    valid_input = WordList<kSize>(matrix->guesses, matrix);
+    pattern_matrix = std::move(matrix);
+  }
+
+private:
+  using pattern_type = Pattern::type<kSize>;
+
+  // below this answers per bucket ratio, sorting the patterns is cheaper than
+  // touching a 3^kSize counter table
+  static inline constexpr const uint64_t kSparseRatio = 16;
+
+  // answers counted between two checks against the best score
+  static inline constexpr const std::size_t kChunk = 1024;
+
+  // guesses scored before bounding the others
+  static inline constexpr const std::size_t kSeeds = 64;
+
+  // score of a guess and its index in valid_input
+  using Ranked = std::tuple<uint64_t, uint32_t>;
+
+  // higher score first, then lower index
+  static inline bool better(const Ranked &a, const Ranked &b) noexcept {
+    return std::get<0>(a) != std::get<0>(b) ? std::get<0>(a) > std::get<0>(b)
+                                            : std::get<1>(a) < std::get<1>(b);
+  }
+
+  struct Scratch {
+    std::vector<uint32_t> buckets;
+    std::vector<pattern_type> patterns;
+    std::vector<uint64_t> presence;
+    // heap of the best guesses scored by this thread, worst on top
+    std::vector<Ranked> ranked;
+  };
+
+  // pattern_matrix still indexed by the word lists, false once they were
+  // replaced
+  bool use_matrix() const noexcept {
+    return pattern_matrix &&
+           possible_answer.words().data() == pattern_matrix->answers.data() &&
+           valid_input.words().data() == pattern_matrix->guesses.data();
+  }
+
+  // the searches below run over the answers possible, a subset of
+  // possible_answer for the subproblems of a lookahead, so that those share
+  // the alphabet, the valid inputs and the matrix of this context
+
+  // one row per symbol, bit i of a row is set when answer i of possible
+  // holds the symbol
+  inline std::vector<uint64_t>
+  symbol_presence(const WordList<kSize> &possible,
+                  Progress *progress) const noexcept;
+
+  // the kSeeds guesses whose distinct symbols are held by the most answers
+  inline std::vector<uint32_t>
+  common_guesses(const WordList<kSize> &possible,
+                 std::span<const uint64_t> presence,
+                 Progress *progress) const noexcept;
+
+  // upper bound of the score of word, answers sharing no symbol with word
+  // all fall into the all grey bucket and the others at best spread evenly
+  // over the remaining patterns
+  template <typename Policy>
+  inline uint64_t score_bound(const Policy &policy,
+                              const WordList<kSize> &possible,
+                              std::span<const symbol_type, kSize> word,
+                              std::span<const uint64_t> presence,
+                              std::span<uint64_t> scratch) const noexcept;
+
+  // tbb::parallel_for over [0, size), in the group of progress if any
+  template <typename Body>
+  static inline void for_each_range(std::size_t size, const Body &body,
+                                    Progress *progress) noexcept {
+    const tbb::blocked_range<size_t> range(0, size);
+    if (progress) {
+      tbb::parallel_for(range, body, progress->group());
+    } else {
+      tbb::parallel_for(range, body);
+    }
+  }
+
+  // the count best guesses ranked by policy, best first, cut short once
+  // progress is cancelled
+  template <typename Policy>
+  inline std::vector<Ranked> rank(const Policy &policy,
+                                  const WordList<kSize> &possible,
+                                  std::size_t count,
+                                  Progress *progress) const noexcept;
+
+  // entry points of the searches, not inline so that WORDLE_EXTERN_TEMPLATES
+  // leaves them to the library
+  template <typename Policy>
+  std::optional<Best> best_candidate(Progress *progress) const noexcept;
+
+  template <typename Policy>
+  std::optional<std::vector<Candidate>>
+  top_candidates(std::size_t count, Progress *progress) const noexcept;
+
+  // spreads the depth over the seed of a memo key
+  static inline constexpr const uint64_t kDepthSeed =
+      UINT64_C(0x9e3779b97f4a7c15);
+
+  // one lookahead search, every subproblem keeps the valid inputs it
+  // started with and stops once progress is cancelled
+  struct Search {
+    std::size_t width;
+    uint64_t inputs;
+    Memo &memo;
+    Progress *progress;
+  };
+
+  static inline uint64_t fingerprint(std::span<const uint32_t> indexes,
+                                     uint64_t seed) noexcept {
+    constexpr const uint64_t kPrime = UINT64_C(0x100000001b3);
+    uint64_t result = seed;
+    for (const auto index : indexes) {
+      result = (result ^ index) * kPrime;
+      result ^= result >> 29;
+    }
+    return result;
+  }
+
+  // key of the answer set in solved_cache
+  template <typename Policy> inline uint64_t solved_key() const noexcept {
+    const auto words = reinterpret_cast<uintptr_t>(valid_input.words().data());
+    const auto seed = fingerprint(
+        valid_input.indexes(),
+        words ^ static_cast<uint64_t>(Score::metric_of<Policy>()));
+    return fingerprint(possible_answer.indexes(), seed);
+  }
+
+  template <typename Policy>
+  std::optional<Best> lookahead_candidate(std::size_t depth, std::size_t width,
+                                          Memo *memo,
+                                          Progress *progress) const noexcept;
+
+  // expected guess count and valid_input index of the best of the width
+  // guesses ranked first by Policy, depth guesses deep, reported to progress
+  template <typename Policy>
+  inline std::optional<std::tuple<double, uint32_t>>
+  lookahead(const WordList<kSize> &possible, std::size_t depth,
+            const Search &search, Progress *progress) const noexcept;
+
+  // expected guesses to finish after the guess at index of valid_input,
+  // the buckets it leaves of possible are searched depth - 1 guesses deep
+  template <typename Policy>
+  inline double guess_cost(const WordList<kSize> &possible, uint32_t index,
+                           std::size_t depth,
+                           const Search &search) const noexcept;
+
+  // expected guesses to find the answer among possible, depth guesses deep.
+  // past the depth the lower bound of a guess splitting every answer apart
+  // is taken
+  template <typename Policy>
+  inline double expected_guesses(const WordList<kSize> &possible,
+                                 std::size_t depth,
+                                 const Search &search) const noexcept;
+
+  std::optional<std::tuple<uint64_t, uint64_t>>
+  filter_candidate(std::span<const symbol_type, kSize> candidate,
+                   std::span<const char8_t, kSize> result, bool hard_mode,
+                   Progress *progress) noexcept;
+
+  // patterns of the answers possible against the guess at index of
+  // valid_input
+  inline std::vector<pattern_type>
+  guess_patterns(const WordList<kSize> &possible,
+                 std::size_t index) const noexcept {
+    if (!use_matrix()) {
+      return patterns_of(valid_input[index], possible);
+    }
+    const auto row = pattern_matrix->row(valid_input.indexes()[index]);
+    const auto answers = possible.indexes();
+    std::vector<pattern_type> patterns(answers.size());
+    std::transform(answers.begin(), answers.end(), patterns.begin(),
+                   [&row](uint32_t answer) noexcept { return row[answer]; });
+    return patterns;
+  }
+
+  static inline std::vector<pattern_type>
+  patterns_of(std::span<const symbol_type, kSize> word,
+              const WordList<kSize> &words,
+              Progress *progress = nullptr) noexcept {
+    const Pattern::Columns<kSize> columns(words.words(), words.indexes());
+    std::vector<pattern_type> patterns(words.size());
+    for_each_range(
+        words.size(),
+        [&word, &columns, &patterns,
+         progress](const tbb::blocked_range<size_t> &range) noexcept {
+          Pattern::calculate<kSize>(
+              word, columns, range.begin(),
+              std::span(patterns).subspan(range.begin(), range.size()));
+          if (progress) {
+            progress->advance(range.size());
+          }
+        },
+        progress);
+    return patterns;
+  }
+
+  // keep the words whose pattern equals expected, returns the removed count
+  static inline uint64_t filter(WordList<kSize> &words,
+                                std::span<const pattern_type> patterns,
+                                uint64_t expected) noexcept {
+    return words.filter([&patterns, expected](size_t position) noexcept {
+      return patterns[position] == expected;
+    });
+  }
+
+  // counts patterns filled by fill(first, count) chunk by chunk, gives up
+  // with 0 once the score can not reach best even if every answer left
+  // lands in a bucket of its own
+  template <typename Policy, typename Fill>
+  static inline uint64_t
+  dense_score(const Policy &policy, std::span<const pattern_type> patterns,
+              std::span<uint32_t> buckets, Fill &&fill,
+              const std::atomic<uint64_t> &best) noexcept {
+    const uint64_t total = patterns.size();
+    uint64_t measure = 0;
+    size_t done = 0;
+    bool abandoned = false;
+    while (done < total) {
+      const size_t count = std::min<size_t>(kChunk, total - done);
+      fill(done, count);
+      for (const auto pattern : patterns.subspan(done, count)) {
+        measure = policy.add(measure, buckets[pattern]++);
+      }
+      done += count;
+      if (policy.key(policy.buckets(measure, 1, total - done), true) <
+          best.load(std::memory_order_relaxed)) {
+        abandoned = true;
+        break;
+      }
+    }
+    const bool exact = buckets.back() != 0;
+    for (const auto pattern : patterns.first(done)) {
+      buckets[pattern] = 0;
+    }
+    return abandoned ? 0 : policy.key(measure, exact);
+  }
+
+  template <typename Policy>
+  static inline uint64_t
+  sparse_score(const Policy &policy,
+               std::span<pattern_type> patterns) noexcept {
+    std::sort(patterns.begin(), patterns.end());
+    uint64_t measure = 0;
+    for (auto first = patterns.begin(); first != patterns.end();) {
+      const auto last =
+          std::find_if(first, patterns.end(),
+                       [value = *first](pattern_type pattern) noexcept {
+                         return pattern != value;
+                       });
+      measure = policy.buckets(measure, std::distance(first, last), 1);
+      first = last;
+    }
+    const bool exact =
+        !patterns.empty() && patterns.back() == Pattern::count<kSize> - 1;
+    return policy.key(measure, exact);
+  }
 };
 
 template <std::size_t kSize>
-std::tuple<double, std::span<const char32_t, kSize>>
-Context<kSize>::find_best_candidate() const noexcept {
-  if (possible_answer.size() == 1) {
-    return {1, possible_answer.front()};
-  }
-  auto find_excluded = [this](const std::array<char32_t, kSize> &word) noexcept
-      -> std::tuple<uint64_t, std::span<const char32_t, kSize>> {
-    auto power = [](uint64_t base, uint64_t factor) constexpr noexcept {
-      uint64_t result = 1;
-      for (uint64_t index = 0; index < factor; ++index) {
-        result *= base;
+bool Context<kSize>::build_pattern_matrix(uint64_t memory_limit) noexcept {
+  if (Pattern::Matrix<kSize>::memory_usage(valid_input.size(),
+                                           possible_answer.size()) >
+      memory_limit) {
+    return false;
+  }
+
+  pattern_matrix = Pattern::Matrix<kSize>::build(
+      alphabet, {valid_input.begin(), valid_input.end()},
+      {possible_answer.begin(), possible_answer.end()});
+  possible_answer = WordList<kSize>(pattern_matrix->answers, pattern_matrix);
+  valid_input = WordList<kSize>(pattern_matrix->guesses, pattern_matrix);
+  return true;
+}
+
+template <std::size_t kSize>
+std::vector<uint64_t>
+Context<kSize>::symbol_presence(const WordList<kSize> &possible,
+                                Progress *progress) const noexcept {
+  const size_t blocks = (possible.size() + 63) / 64;
+  std::vector<uint64_t> presence(alphabet.symbols.size() * blocks);
+  // a task owns the words of whole blocks
+  for_each_range(
+      blocks,
+      [this, &possible, blocks,
+       &presence](const tbb::blocked_range<size_t> &range) {
+        const size_t last =
+            std::min(range.end() * 64, possible.size());
+        for (size_t index = range.begin() * 64; index < last; ++index) {
+          for (const auto symbol : possible[index]) {
+            if (symbol < alphabet.symbols.size()) {
+              presence[symbol * blocks + index / 64] |= UINT64_C(1)
+                                                        << (index % 64);
+            }
+          }
+        }
+      },
+      progress);
+  return presence;
+}
+
+template <std::size_t kSize>
+std::vector<uint32_t>
+Context<kSize>::common_guesses(const WordList<kSize> &possible,
+                               std::span<const uint64_t> presence,
+                               Progress *progress) const noexcept {
+  const size_t blocks = (possible.size() + 63) / 64;
+  std::vector<uint64_t> holders(alphabet.symbols.size());
+  for (size_t symbol = 0; symbol < holders.size(); ++symbol) {
+    for (const auto block : presence.subspan(symbol * blocks, blocks)) {
+      holders[symbol] += std::popcount(block);
+    }
+  }
+  std::vector<uint64_t> commons(valid_input.size());
+  for_each_range(
+      valid_input.size(),
+      [this, &holders, &commons](const tbb::blocked_range<size_t> &range) {
+        for (size_t index = range.begin(); index != range.end(); ++index) {
+          const auto &word = valid_input[index];
+          for (size_t position = 0; position < kSize; ++position) {
+            const auto symbol = word[position];
+            if (symbol < holders.size() &&
+                std::find(word.begin(), word.begin() + position, symbol) ==
+                    word.begin() + position) {
+              commons[index] += holders[symbol];
+            }
+          }
+        }
+      },
+      progress);
+  std::vector<uint32_t> seeds(valid_input.size());
+  std::iota(seeds.begin(), seeds.end(), 0);
+  const auto last = seeds.begin() + std::min(kSeeds, seeds.size());
+  std::partial_sort(seeds.begin(), last, seeds.end(),
+                    [&commons](uint32_t a, uint32_t b) noexcept {
+                      return commons[a] != commons[b] ? commons[a] > commons[b]
+                                                      : a < b;
+                    });
+  seeds.erase(last, seeds.end());
+  return seeds;
+}
+
+template <std::size_t kSize>
+template <typename Policy>
+uint64_t
+Context<kSize>::score_bound(const Policy &policy,
+                            const WordList<kSize> &possible,
+                            std::span<const symbol_type, kSize> word,
+                            std::span<const uint64_t> presence,
+                            std::span<uint64_t> scratch) const noexcept {
+  const uint64_t total = possible.size();
+  const size_t blocks = (total + 63) / 64;
+  const bool exact = std::binary_search(
+      possible.begin(), possible.end(), word,
+      [](const auto &a, const auto &b) noexcept {
+        return std::lexicographical_compare(a.begin(), a.end(), b.begin(),
+                                            b.end());
+      });
+  std::fill(scratch.begin(), scratch.begin() + blocks, 0);
+  for (const auto symbol : word) {
+    if (symbol >= alphabet.symbols.size()) {
+      // symbols outside the alphabet are never present
+      continue;
+    }
+    const auto row = presence.subspan(symbol * blocks, blocks);
+    for (size_t block = 0; block < blocks; ++block) {
+      scratch[block] |= row[block];
+    }
+  }
+  uint64_t touched = 0;
+  for (size_t block = 0; block < blocks; ++block) {
+    touched += std::popcount(scratch[block]);
+  }
+  const uint64_t greys = total - touched;
+  // the smallest measure of touched answers over the other patterns
+  const uint64_t buckets =
+      std::max<uint64_t>(std::min<uint64_t>(touched, Pattern::count<kSize> - 1),
+                         1);
+  const uint64_t quotient = touched / buckets;
+  const uint64_t remainder = touched % buckets;
+  uint64_t measure = policy.buckets(0, greys, 1);
+  measure = policy.buckets(measure, quotient + 1, remainder);
+  measure = policy.buckets(measure, quotient, buckets - remainder);
+  return policy.key(measure, exact);
+}
+
+template <std::size_t kSize>
+template <typename Policy>
+std::vector<typename Context<kSize>::Ranked>
+Context<kSize>::rank(const Policy &policy, const WordList<kSize> &possible,
+                     std::size_t count, Progress *progress) const noexcept {
+  if (count == 0) {
+    return {};
+  }
+  if (progress) {
+    // every guess is bounded, then scored or skipped
+    progress->start(UINT64_C(2) * valid_input.size(), valid_input.size());
+  }
+  const bool matrix = use_matrix();
+  const auto answers = possible.indexes();
+  const bool sparse = possible.size() * kSparseRatio < Pattern::count<kSize>;
+  const Pattern::Columns<kSize> columns(possible.words(), answers);
+  tbb::enumerable_thread_specific<Scratch> scratches;
+
+  // every thread keeps its own count best guesses, the worst of them is a
+  // lower bound of the count-th best score overall. a skipped guess can not
+  // reach that bound, so it can not tie with a kept guess either and the
+  // first indexes are kept
+  std::atomic<uint64_t> best_score = 0;
+  const auto prepare = [&possible, sparse](Scratch &scratch) noexcept {
+    scratch.patterns.resize(possible.size());
+    if (!sparse) {
+      scratch.buckets.resize(Pattern::count<kSize>);
+    }
+  };
+  const auto score_guess = [this, &possible, matrix, &answers, sparse,
+                            &columns, &policy, &best_score, count,
+                            progress](Scratch &scratch,
+                                      uint32_t index) noexcept {
+    const auto &word = valid_input[index];
+    std::optional<uint32_t> guess;
+    if (matrix) {
+      guess = valid_input.indexes()[index];
+    }
+    // patterns of the answers [first, first + count)
+    const auto fill = [this, &answers, &columns, &scratch, &word,
+                       &guess](size_t first, size_t count) noexcept {
+      const auto patterns = std::span(scratch.patterns).subspan(first, count);
+      if (guess) {
+        const auto row = pattern_matrix->row(*guess);
+        std::transform(answers.begin() + first,
+                       answers.begin() + first + count, patterns.begin(),
+                       [&row](uint32_t answer) noexcept {
+                         return row[answer];
+                       });
+      } else {
+        Pattern::calculate<kSize>(word, columns, first, patterns);
       }
-      return result;
     };
-    auto serialize =
-        [](const std::array<char8_t, kSize> &result) constexpr noexcept {
-      return std::accumulate(
-          result.begin(), result.end(), UINT64_C(0),
-          [](uint64_t a, uint64_t b) constexpr noexcept {
-            return a * UINT64_C(3) + b;
-          });
-    };
-
-    std::array<uint64_t, power(3, kSize)> buckets = {};
-    for (const auto &answer : possible_answer) {
-      auto result = calculate(word, answer);
-      ++buckets[serialize(result)];
+    uint64_t score;
+    if (sparse) {
+      fill(0, possible.size());
+      score = sparse_score(policy, scratch.patterns);
+    } else {
+      score = dense_score(policy, scratch.patterns, scratch.buckets, fill,
+                          best_score);
+    }
+    uint64_t best = best_score.load(std::memory_order_relaxed);
+    if (score < best) {
+      // abandoned, or below another thread's bound
+      return;
     }
-    uint64_t excluded = 0;
-    for (const auto &count : buckets) {
-      excluded += count * (possible_answer.size() - count);
+    if (progress) {
+      progress->improve(score, policy.value(score), index);
     }
-    // exact bias
-    if (buckets.back()) {
-      ++excluded;
+    auto &ranked = scratch.ranked;
+    const Ranked entry{score, index};
+    if (ranked.size() < count) {
+      ranked.push_back(entry);
+      std::push_heap(ranked.begin(), ranked.end(), better);
+    } else if (better(entry, ranked.front())) {
+      std::pop_heap(ranked.begin(), ranked.end(), better);
+      ranked.back() = entry;
+      std::push_heap(ranked.begin(), ranked.end(), better);
+    }
+    if (ranked.size() < count) {
+      return;
+    }
+    const uint64_t bound = std::get<0>(ranked.front());
+    while (best < bound && !best_score.compare_exchange_weak(
+                               best, bound, std::memory_order_relaxed)) {
     }
-    return {excluded, word};
   };
 
-  std::array<const char32_t, kSize> empty{};
-  std::vector<std::tuple<uint64_t, std::span<const char32_t, kSize>>>
-      all_excluded(valid_input.size(), {0, empty});
-  std::transform(std::execution::par_unseq, valid_input.begin(),
-                 valid_input.end(), all_excluded.begin(), find_excluded);
-  const auto [excluded, candidate] = *std::max_element(
-      std::execution::par, all_excluded.begin(), all_excluded.end(),
-      [](const auto &a, const auto &b) constexpr noexcept {
-        return std::get<0>(a) < std::get<0>(b);
-      });
-  return {static_cast<double>(excluded) /
-              static_cast<double>(possible_answer.size()),
-          candidate};
+  // a few guesses made of the most common symbols are scored before the
+  // bounds, which take long on large datasets. they give a fair answer
+  // early and a best score to prune against from the start
+  const auto presence = symbol_presence(possible, progress);
+  const auto seeds = common_guesses(possible, presence, progress);
+  std::vector<bool> seeded(valid_input.size());
+  for (const auto index : seeds) {
+    seeded[index] = true;
+  }
+  for_each_range(
+      seeds.size(),
+      [&prepare, &score_guess, &scratches, &seeds,
+       progress](const tbb::blocked_range<size_t> &range) noexcept {
+        auto &scratch = scratches.local();
+        prepare(scratch);
+        for (size_t position = range.begin(); position != range.end();
+             ++position) {
+          if (progress && progress->cancelled()) {
+            break;
+          }
+          score_guess(scratch, seeds[position]);
+        }
+      },
+      progress);
+
+  // score the most promising guesses first, so the best score rises quickly
+  // and guesses bounded below it are skipped
+  std::vector<uint64_t> bounds(valid_input.size());
+  for_each_range(
+      valid_input.size(),
+      [this, &policy, &possible, &presence, &scratches, &bounds,
+       progress](const tbb::blocked_range<size_t> &range) noexcept {
+        auto &scratch = scratches.local();
+        scratch.presence.resize((possible.size() + 63) / 64);
+        for (size_t index = range.begin(); index != range.end(); ++index) {
+          bounds[index] = score_bound(policy, possible, valid_input[index],
+                                      presence, scratch.presence);
+        }
+        if (progress) {
+          progress->advance(range.size());
+        }
+      },
+      progress);
+  if (progress && progress->cancelled()) {
+    return {};
+  }
+  std::vector<uint32_t> order(valid_input.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&bounds](uint32_t a, uint32_t b) noexcept {
+                     return bounds[a] > bounds[b];
+                   });
+
+  for_each_range(
+      order.size(),
+      [&prepare, &score_guess, &scratches, &order, &bounds, &seeded,
+       &best_score,
+       progress](const tbb::blocked_range<size_t> &range) noexcept {
+        auto &scratch = scratches.local();
+        prepare(scratch);
+        for (size_t position = range.begin(); position != range.end();
+             ++position) {
+          if (progress) {
+            if (progress->cancelled()) {
+              break;
+            }
+            progress->advance(1);
+          }
+          const auto index = order[position];
+          if (seeded[index] ||
+              bounds[index] < best_score.load(std::memory_order_relaxed)) {
+            continue;
+          }
+          score_guess(scratch, index);
+        }
+      },
+      progress);
+  if (progress && progress->cancelled()) {
+    return {};
+  }
+
+  std::vector<Ranked> ranked;
+  for (const auto &scratch : scratches) {
+    ranked.insert(ranked.end(), scratch.ranked.begin(), scratch.ranked.end());
+  }
+  const auto last = ranked.begin() + std::min(count, ranked.size());
+  std::partial_sort(ranked.begin(), last, ranked.end(), better);
+  ranked.erase(last, ranked.end());
+  return ranked;
 }
 
 template <std::size_t kSize>
-std::tuple<uint64_t, uint64_t>
-Context<kSize>::input_candidate(std::span<const char32_t, kSize> candidate,
-                                std::span<const char8_t, kSize> result,
-                                bool hard_mode) noexcept {
-  auto check_remove =
-      [&candidate, &result ](const auto &word) constexpr noexcept {
-    const auto compared = calculate(candidate, word);
-    return !std::equal(std::execution::unseq, compared.begin(), compared.end(),
-                       result.begin(), result.end());
-  };
+template <typename Policy>
+std::optional<typename Context<kSize>::Best>
+Context<kSize>::best_candidate(Progress *progress) const noexcept {
+  const Policy policy(possible_answer.size());
+  if (possible_answer.size() == 1) {
+    return Best{policy.value(policy.key(policy.buckets(0, 1, 1), true)),
+                possible_answer.front()};
+  }
+  std::optional<uint64_t> key;
+  if (solved_cache) {
+    key = solved_key<Policy>();
+    if (const auto solved = solved_cache->find(*key)) {
+      return Best{solved->value, valid_input.words()[solved->guess]};
+    }
+  }
+  const auto ranked = rank(policy, possible_answer, 1, progress);
+  if (ranked.empty()) {
+    return std::nullopt;
+  }
+  const auto [score, index] = ranked.front();
+  if (key) {
+    solved_cache->insert(
+        *key, {policy.value(score), valid_input.indexes()[index]});
+  }
+  return Best{policy.value(score), valid_input[index]};
+}
+
+template <std::size_t kSize>
+template <typename Policy>
+std::optional<std::vector<typename Context<kSize>::Candidate>>
+Context<kSize>::top_candidates(std::size_t count,
+                               Progress *progress) const noexcept {
+  const Policy policy(possible_answer.size());
+  const auto ranked = rank(policy, possible_answer, count, progress);
+  if (progress && progress->cancelled()) {
+    return std::nullopt;
+  }
+  std::vector<Candidate> candidates;
+  for (const auto &[score, index] : ranked) {
+    // only the few ranked guesses get their buckets counted
+    auto patterns = guess_patterns(possible_answer, index);
+    std::sort(patterns.begin(), patterns.end());
+    std::vector<uint32_t> buckets;
+    for (auto first = patterns.begin(); first != patterns.end();) {
+      const auto last =
+          std::find_if(first, patterns.end(),
+                       [value = *first](pattern_type pattern) noexcept {
+                         return pattern != value;
+                       });
+      buckets.push_back(std::distance(first, last));
+      first = last;
+    }
+    std::sort(buckets.begin(), buckets.end(), std::greater<>());
+    const bool possible =
+        !patterns.empty() && patterns.back() == Pattern::count<kSize> - 1;
+    candidates.push_back({policy.value(score), valid_input[index], possible,
+                          std::move(buckets)});
+  }
+  return candidates;
+}
+
+template <std::size_t kSize>
+template <typename Policy>
+std::optional<typename Context<kSize>::Best>
+Context<kSize>::lookahead_candidate(std::size_t depth, std::size_t width,
+                                    Memo *memo,
+                                    Progress *progress) const noexcept {
+  if (possible_answer.size() == 1) {
+    return Best{1.0, possible_answer.front()};
+  }
+  Memo local;
+  const Search search{std::max<std::size_t>(width, 1),
+                      fingerprint(valid_input.indexes(), valid_input.size()),
+                      memo ? *memo : local, progress};
+  const auto best =
+      lookahead<Policy>(possible_answer, std::max<std::size_t>(depth, 1),
+                        search, progress);
+  if (!best) {
+    return std::nullopt;
+  }
+  return Best{std::get<0>(*best), valid_input[std::get<1>(*best)]};
+}
 
-  uint64_t possible_answer_removed;
-  uint64_t possible_answer_remained;
-  {
-    const auto erase_begin =
-        std::remove_if(std::execution::par_unseq, possible_answer.begin(),
-                       possible_answer.end(), check_remove);
-    possible_answer_removed = std::distance(erase_begin, possible_answer.end());
-    possible_answer.erase(erase_begin, possible_answer.end());
-    possible_answer.shrink_to_fit();
-    possible_answer_remained = possible_answer.size();
+template <std::size_t kSize>
+template <typename Policy>
+std::optional<std::tuple<double, uint32_t>>
+Context<kSize>::lookahead(const WordList<kSize> &possible, std::size_t depth,
+                          const Search &search,
+                          Progress *progress) const noexcept {
+  // the subproblems below only stop on cancel, the top search reports
+  const auto ranked =
+      rank(Policy(possible.size()), possible, search.width, progress);
+  if (ranked.empty() || (search.progress && search.progress->cancelled())) {
+    return std::nullopt;
+  }
+  if (progress) {
+    progress->start(ranked.size(), valid_input.size());
   }
+  // candidates and the buckets under them are searched as parallel tasks
+  std::vector<double> costs(ranked.size());
+  for_each_range(
+      ranked.size(),
+      [this, &possible, depth, &search, &ranked, &costs,
+       progress](const tbb::blocked_range<size_t> &range) noexcept {
+        for (size_t position = range.begin(); position != range.end();
+             ++position) {
+          if (search.progress && search.progress->cancelled()) {
+            break;
+          }
+          const auto index = std::get<1>(ranked[position]);
+          costs[position] =
+              guess_cost<Policy>(possible, index, depth, search);
+          if (progress) {
+            // fewer guesses is better, the key grows the other way
+            progress->improve(UINT64_MAX - static_cast<uint64_t>(
+                                               costs[position] * 1e12),
+                              costs[position], index);
+            progress->advance(1);
+          }
+        }
+      },
+      search.progress);
+  if (search.progress && search.progress->cancelled()) {
+    return std::nullopt;
+  }
+  // ties go to the guess Policy ranks first
+  const auto best = std::distance(
+      costs.begin(), std::min_element(costs.begin(), costs.end()));
+  return std::tuple{costs[best], std::get<1>(ranked[best])};
+}
 
+template <std::size_t kSize>
+template <typename Policy>
+double Context<kSize>::guess_cost(const WordList<kSize> &possible,
+                                  uint32_t index, std::size_t depth,
+                                  const Search &search) const noexcept {
+  const auto patterns = guess_patterns(possible, index);
+  // positions grouped by pattern, ascending within a bucket
+  std::vector<uint32_t> order(patterns.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&patterns](uint32_t a, uint32_t b) noexcept {
+                     return patterns[a] < patterns[b];
+                   });
+  std::vector<size_t> firsts;
+  for (size_t position = 0; position < order.size(); ++position) {
+    if (position == 0 ||
+        patterns[order[position]] != patterns[order[position - 1]]) {
+      firsts.push_back(position);
+    }
+  }
+  firsts.push_back(order.size());
+
+  // guesses of every bucket weighted by its answers, kept apart so the sum
+  // does not depend on the task order
+  std::vector<double> costs(firsts.size() - 1);
+  for_each_range(
+      costs.size(),
+      [this, &possible, depth, &search, &patterns, &order, &firsts,
+       &costs](const tbb::blocked_range<size_t> &range) noexcept {
+        for (size_t bucket = range.begin(); bucket != range.end(); ++bucket) {
+          if (search.progress && search.progress->cancelled()) {
+            break;
+          }
+          const auto first = firsts[bucket];
+          const auto count = firsts[bucket + 1] - first;
+          if (patterns[order[first]] == Pattern::count<kSize> - 1) {
+            // the guess was the answer
+            continue;
+          }
+          // only the answers are copied, the rest is shared through this
+          const auto subproblem =
+              possible.select(std::span(order).subspan(first, count));
+          costs[bucket] =
+              static_cast<double>(count) *
+              expected_guesses<Policy>(subproblem, depth - 1, search);
+        }
+      },
+      search.progress);
+  return 1.0 + std::accumulate(costs.begin(), costs.end(), 0.0) /
+                   static_cast<double>(patterns.size());
+}
+
+template <std::size_t kSize>
+template <typename Policy>
+double Context<kSize>::expected_guesses(const WordList<kSize> &possible,
+                                        std::size_t depth,
+                                        const Search &search) const noexcept {
+  const auto count = static_cast<double>(possible.size());
+  if (possible.size() <= 1) {
+    return count;
+  }
+  if (possible.size() == 2 || depth == 0) {
+    // one answer guessed right away, the others one guess later
+    return 2.0 - 1.0 / count;
+  }
+  const auto key = fingerprint(possible.indexes(),
+                               search.inputs + depth * kDepthSeed);
+  if (const auto cost = search.memo.find(key)) {
+    return *cost;
+  }
+  const auto best = lookahead<Policy>(possible, depth, search, nullptr);
+  const double cost = best ? std::get<0>(*best) : 2.0 - 1.0 / count;
+  if (search.progress && search.progress->cancelled()) {
+    // cut short, not worth keeping
+    return cost;
+  }
+  search.memo.insert(key, cost);
+  return cost;
+}
+
+template <std::size_t kSize>
+std::optional<std::tuple<uint64_t, uint64_t>>
+Context<kSize>::filter_candidate(std::span<const symbol_type, kSize> candidate,
+                                 std::span<const char8_t, kSize> result,
+                                 bool hard_mode, Progress *progress) noexcept {
+  const auto expected = Pattern::serialize<kSize>(result);
+  if (progress) {
+    progress->start(possible_answer.size() +
+                    (hard_mode ? valid_input.size() : 0));
+  }
+  const auto patterns = answer_patterns(candidate, progress);
+  std::vector<pattern_type> input_patterns;
   if (hard_mode) {
-    const auto erase_begin =
-        std::remove_if(std::execution::par_unseq, valid_input.begin(),
-                       valid_input.end(), check_remove);
-    valid_input.erase(erase_begin, valid_input.end());
-    valid_input.shrink_to_fit();
+    input_patterns = patterns_of(candidate, valid_input, progress);
+  }
+  // nothing is filtered until every pattern is known
+  if (progress && progress->cancelled()) {
+    return std::nullopt;
   }
 
-  return {possible_answer_removed, possible_answer_remained};
+  const uint64_t possible_answer_removed =
+      filter(possible_answer, patterns, expected);
+  const uint64_t possible_answer_remained = possible_answer.size();
+  if (hard_mode) {
+    filter(valid_input, input_patterns, expected);
+  }
+  return std::tuple{possible_answer_removed, possible_answer_remained};
 }
 
 template <std::size_t kSize>
 constexpr std::array<char8_t, kSize>
-Context<kSize>::calculate(std::span<const char32_t, kSize> word,
-                          std::span<const char32_t, kSize> problem) noexcept {
-  std::array<std::tuple<char32_t, uint8_t>, kSize> alphabits;
+Context<kSize>::calculate(
+    std::span<const symbol_type, kSize> word,
+    std::span<const symbol_type, kSize> problem) noexcept {
+  std::array<std::tuple<symbol_type, uint8_t>, kSize> alphabits;
   size_t alphabit_size = 0;
 
   auto increase =
-      [&alphabits, &alphabit_size ](char32_t char_) constexpr noexcept {
+      [&alphabits, &alphabit_size ](symbol_type char_) constexpr noexcept {
     for (size_t index = 0; index < alphabit_size; ++index) {
       auto &[key, count] = alphabits[index];
       if (key == char_) {
@@ -152,7 +1059,7 @@ Context<kSize>::calculate(std::span<const char32_t, kSize> word,
     alphabits[alphabit_size++] = {char_, 1};
   };
   auto decrease =
-      [&alphabits, &alphabit_size ](char32_t char_) constexpr noexcept {
+      [&alphabits, &alphabit_size ](symbol_type char_) constexpr noexcept {
     for (size_t index = 0; index < alphabit_size; ++index) {
       auto &[key, count] = alphabits[index];
       if (key == char_) {
@@ -187,3 +1094,38 @@ Context<kSize>::calculate(std::span<const char32_t, kSize> word,
 
   return result;
 }
+
+// explicit instantiations of every size and policy with prefix `extern`
+// to declare them or nothing to define them, the wordle_core library defines
+// them once and programs linking it get WORDLE_EXTERN_TEMPLATES
+#define WORDLE_CONTEXT_POLICY(prefix, kSize, Policy)                          \
+  prefix template std::optional<Context<kSize>::Best>                         \
+  Context<kSize>::best_candidate<Policy>(Progress *) const noexcept;          \
+  prefix template std::optional<std::vector<Context<kSize>::Candidate>>       \
+  Context<kSize>::top_candidates<Policy>(std::size_t, Progress *)             \
+      const noexcept;                                                         \
+  prefix template std::optional<Context<kSize>::Best>                         \
+  Context<kSize>::lookahead_candidate<Policy>(                                \
+      std::size_t, std::size_t, Context<kSize>::Memo *, Progress *)           \
+      const noexcept;
+
+#define WORDLE_CONTEXT_SIZE(prefix, kSize)                                    \
+  prefix template class Context<kSize>;                                       \
+  WORDLE_CONTEXT_POLICY(prefix, kSize, Score::Excluded)                       \
+  WORDLE_CONTEXT_POLICY(prefix, kSize, Score::Entropy)                        \
+  WORDLE_CONTEXT_POLICY(prefix, kSize, Score::Expected)                       \
+  WORDLE_CONTEXT_POLICY(prefix, kSize, Score::Minimax)
+
+#define WORDLE_CONTEXT_INSTANCES(prefix)                                      \
+  WORDLE_CONTEXT_SIZE(prefix, 4)                                              \
+  WORDLE_CONTEXT_SIZE(prefix, 5)                                              \
+  WORDLE_CONTEXT_SIZE(prefix, 6)                                              \
+  WORDLE_CONTEXT_SIZE(prefix, 7)                                              \
+  WORDLE_CONTEXT_SIZE(prefix, 8)                                              \
+  WORDLE_CONTEXT_SIZE(prefix, 9)                                              \
+  WORDLE_CONTEXT_SIZE(prefix, 10)                                             \
+  WORDLE_CONTEXT_SIZE(prefix, 11)
+
+#ifdef WORDLE_EXTERN_TEMPLATES
+WORDLE_CONTEXT_INSTANCES(extern)
+#endif
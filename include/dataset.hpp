@@ -2,13 +2,28 @@
 // SPDX-FileCopyrightText: 2022 Shen-Ta Hsieh
 
 #pragma once
+#include "alphabet.hpp"
+#include "cache.hpp"
+#include "word_list.hpp"
+#include <algorithm>
 #include <array>
-#include <codecvt>
+#include <bit>
+#include <cstdint>
+#include <cstring>
 #include <execution>
+#include <fcntl.h>
 #include <filesystem>
-#include <fstream>
-#include <locale>
+#include <memory>
+#include <numeric>
 #include <optional>
+#include <string>
+#include <string_view>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/parallel_invoke.h>
+#include <unistd.h>
 #include <vector>
 
 namespace Dataset {
@@ -18,34 +33,450 @@ static inline constexpr const auto kPossible = "possible.txt"sv;
 static inline constexpr const auto kValid = "valid.txt"sv;
 static inline constexpr const auto kData = "data"sv;
 
+static inline constexpr const std::array<char, 8> kPackedMagic{
+    'W', 'O', 'R', 'D', 'L', 'E', 'W', 'L'};
+static inline constexpr const uint32_t kPackedVersion = 1;
+
+// bytes per task when splitting a file into lines
+static inline constexpr const std::size_t kChunk = std::size_t(64) << 10;
+
+// a whole file mapped read only, unmapped with the last owner
+struct Mapping {
+  std::shared_ptr<const void> owner;
+  std::string_view bytes;
+};
+
+static inline std::optional<Mapping>
+map(const std::filesystem::path &filename) noexcept {
+  const int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return std::nullopt;
+  }
+  struct stat status;
+  if (::fstat(fd, &status) != 0) {
+    ::close(fd);
+    return std::nullopt;
+  }
+  const auto length = static_cast<size_t>(status.st_size);
+  if (length == 0) {
+    // nothing to map
+    ::close(fd);
+    return Mapping{};
+  }
+  void *address = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (address == MAP_FAILED) {
+    return std::nullopt;
+  }
+  return Mapping{
+      std::shared_ptr<const void>(address,
+                                  [length](const void *address) noexcept {
+                                    ::munmap(const_cast<void *>(address),
+                                             length);
+                                  }),
+      {static_cast<const char *>(address), length}};
+}
+
+// whether every byte of text is ascii, eight bytes at a time
+static inline bool is_ascii(std::string_view text) noexcept {
+  uint64_t bits = 0;
+  size_t index = 0;
+  for (; index + sizeof(uint64_t) <= text.size(); index += sizeof(uint64_t)) {
+    uint64_t block;
+    std::memcpy(&block, text.data() + index, sizeof(block));
+    bits |= block;
+  }
+  for (; index < text.size(); ++index) {
+    bits |= static_cast<uint8_t>(text[index]);
+  }
+  return (bits & UINT64_C(0x8080808080808080)) == 0;
+}
+
+// decode a utf-8 line of exactly kSize code points into word, false for
+// other lengths and malformed or overlong sequences
+template <std::size_t kSize>
+static inline bool decode(std::string_view line,
+                          std::array<char32_t, kSize> &word) noexcept {
+  if (line.size() == kSize && is_ascii(line)) {
+    std::copy(line.begin(), line.end(), word.begin());
+    return true;
+  }
+  // smallest code point of each sequence length
+  static constexpr const std::array<char32_t, 5> kMinimum{0, 0, 0x80, 0x800,
+                                                          0x10000};
+  size_t size = 0;
+  for (size_t index = 0; index < line.size();) {
+    if (size == kSize) {
+      return false;
+    }
+    const auto lead = static_cast<uint8_t>(line[index]);
+    size_t length;
+    char32_t code;
+    if (lead < 0x80) {
+      length = 1;
+      code = lead;
+    } else if ((lead & 0xe0) == 0xc0) {
+      length = 2;
+      code = lead & 0x1f;
+    } else if ((lead & 0xf0) == 0xe0) {
+      length = 3;
+      code = lead & 0x0f;
+    } else if ((lead & 0xf8) == 0xf0) {
+      length = 4;
+      code = lead & 0x07;
+    } else {
+      return false;
+    }
+    if (index + length > line.size()) {
+      return false;
+    }
+    for (size_t offset = 1; offset < length; ++offset) {
+      const auto byte = static_cast<uint8_t>(line[index + offset]);
+      if ((byte & 0xc0) != 0x80) {
+        return false;
+      }
+      code = code << 6 | (byte & 0x3f);
+    }
+    if (code < kMinimum[length] || code > 0x10ffff ||
+        (0xd800 <= code && code <= 0xdfff)) {
+      return false;
+    }
+    word[size++] = code;
+    index += length;
+  }
+  return size == kSize;
+}
+
+// line(text) for every line starting in [first, last) of bytes, without
+// its line break
+template <typename Line>
+static inline void for_each_line(std::string_view bytes, size_t first,
+                                 size_t last, Line &&line) noexcept {
+  const auto next_line = [&bytes](size_t first) noexcept {
+    const auto *newline = static_cast<const char *>(
+        std::memchr(bytes.data() + first, '\n', bytes.size() - first));
+    return newline ? static_cast<size_t>(newline - bytes.data())
+                   : bytes.size();
+  };
+  if (first != 0) {
+    // the line holding first belongs to the chunk before
+    first = std::min(next_line(first - 1) + 1, bytes.size());
+  }
+  while (first < last) {
+    const size_t end = next_line(first);
+    auto text = bytes.substr(first, end - first);
+    if (!text.empty() && text.back() == '\r') {
+      text.remove_suffix(1);
+    }
+    line(text);
+    first = end + 1;
+  }
+}
+
+// words of kSize code points in a utf-8 file, one per line, sorted and
+// deduplicated. lines are split and decoded in parallel chunks, counted
+// first so the words are written into a single allocation
 template <std::size_t kSize>
 static inline std::optional<std::vector<std::array<char32_t, kSize>>>
 read(const std::filesystem::path &filename) noexcept {
-  std::ifstream file(filename);
-  if (!file) {
+  const auto mapping = map(filename);
+  if (!mapping) {
     return std::nullopt;
   }
+  const auto bytes = mapping->bytes;
+  const size_t chunks = (bytes.size() + kChunk - 1) / kChunk;
 
-  std::wstring_convert<std::codecvt_utf8_utf16<char32_t>, char32_t> converter;
-  std::vector<std::array<char32_t, kSize>> list;
-  std::string line;
-  while (std::getline(file, line)) {
-    const auto line_utf32 = converter.from_bytes(line);
-    if (line_utf32.size() != kSize) {
-      // ignore wrong words
-      continue;
-    }
+  // words of each chunk, then where they start in the list
+  std::vector<size_t> offsets(chunks + 1);
+  tbb::parallel_for(size_t(0), chunks, [&bytes, &offsets](size_t chunk) {
+    size_t count = 0;
     std::array<char32_t, kSize> word;
-    std::copy(std::execution::par_unseq, line_utf32.begin(), line_utf32.end(),
-              word.begin());
-    list.push_back(word);
-  }
+    for_each_line(bytes, chunk * kChunk,
+                  std::min((chunk + 1) * kChunk, bytes.size()),
+                  [&count, &word](std::string_view line) noexcept {
+                    count += decode<kSize>(line, word);
+                  });
+    offsets[chunk + 1] = count;
+  });
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+  std::vector<std::array<char32_t, kSize>> list(offsets.back());
+  tbb::parallel_for(size_t(0), chunks, [&bytes, &offsets, &list](size_t chunk) {
+    auto next = list.begin() + offsets[chunk];
+    std::array<char32_t, kSize> word;
+    for_each_line(bytes, chunk * kChunk,
+                  std::min((chunk + 1) * kChunk, bytes.size()),
+                  [&next, &word](std::string_view line) noexcept {
+                    if (decode<kSize>(line, word)) {
+                      *next++ = word;
+                    }
+                  });
+  });
 
-  std::sort(std::execution::par_unseq, list.begin(), list.end());
+  // the shipped lists are mostly sorted already
+  if (!std::is_sorted(std::execution::par_unseq, list.begin(), list.end())) {
+    std::sort(std::execution::par_unseq, list.begin(), list.end());
+  }
   list.erase(std::unique(std::execution::par_unseq, list.begin(), list.end()),
              list.end());
-  list.shrink_to_fit();
   return list;
 }
 
+// every word of a dataset in one sorted array shared by both lists, valid
+// is the whole array and possible the answers in it
+template <std::size_t kSize> struct Words {
+  Alphabet alphabet;
+  WordList<kSize> possible;
+  WordList<kSize> valid;
+};
+
+// read both word lists of a dataset concurrently and merge them, encoded
+// with their alphabet, into a single allocation
+template <std::size_t kSize>
+static inline std::optional<Words<kSize>>
+read(const std::filesystem::path &possible,
+     const std::filesystem::path &valid) noexcept {
+  std::optional<std::vector<std::array<char32_t, kSize>>> possible_list;
+  std::optional<std::vector<std::array<char32_t, kSize>>> valid_list;
+  tbb::parallel_invoke(
+      [&possible_list, &possible]() noexcept {
+        possible_list = read<kSize>(possible);
+      },
+      [&valid_list, &valid]() noexcept { valid_list = read<kSize>(valid); });
+  if (!possible_list || !valid_list) {
+    return std::nullopt;
+  }
+  auto alphabet = Alphabet::build<kSize>({*possible_list, *valid_list});
+  if (!alphabet) {
+    return std::nullopt;
+  }
+
+  // both lists are sorted, so one merge makes the union and finds where
+  // each answer landed in it
+  std::vector<Alphabet::word_type<kSize>> words;
+  words.reserve(possible_list->size() + valid_list->size());
+  std::vector<uint32_t> answers;
+  answers.reserve(possible_list->size());
+  const Alphabet::Encoder encoder(*alphabet);
+  auto answer = possible_list->begin();
+  auto input = valid_list->begin();
+  while (answer != possible_list->end() || input != valid_list->end()) {
+    if (answer != possible_list->end() &&
+        (input == valid_list->end() || *answer <= *input)) {
+      if (input != valid_list->end() && *answer == *input) {
+        ++input;
+      }
+      answers.push_back(static_cast<uint32_t>(words.size()));
+      words.push_back(encoder.encode<kSize>(*answer++));
+    } else {
+      words.push_back(encoder.encode<kSize>(*input++));
+    }
+  }
+
+  auto storage = std::make_shared<const decltype(words)>(std::move(words));
+  return Words<kSize>{std::move(*alphabet),
+                      WordList<kSize>(*storage, storage, std::move(answers)),
+                      WordList<kSize>(*storage, storage)};
+}
+
+// packed word lists of one size, written by wordle_dataset_pack next to the
+// text files. the header is followed by the alphabet, the sorted union of
+// both lists with every symbol packed into symbol_bits bits, and a bitmap of
+// the words that are possible answers
+struct PackedHeader {
+  std::array<char, 8> magic;
+  uint32_t version;
+  uint32_t size;
+  uint32_t symbol_count;
+  uint32_t symbol_bits;
+  uint64_t word_count;
+  uint64_t answer_count;
+  uint64_t checksum;
+};
+
+template <std::size_t kSize>
+static inline std::filesystem::path
+packed(const std::filesystem::path &directory) noexcept {
+  return directory / ("words-" + std::to_string(kSize) + ".bin");
+}
+
+static inline constexpr uint32_t symbol_bits(uint64_t symbol_count) noexcept {
+  return std::max<uint32_t>(
+      1, std::bit_width(std::max(symbol_count, UINT64_C(1)) - 1));
+}
+
+// lanes of the packed words, one spare so every symbol is read with a single
+// unaligned load
+template <std::size_t kSize>
+static inline constexpr uint64_t packed_lanes(uint64_t word_count,
+                                              uint32_t bits) noexcept {
+  return (word_count * kSize * bits + 63) / 64 + 1;
+}
+
+template <std::size_t kSize>
+static inline bool write_packed(const std::filesystem::path &filename,
+                                const Words<kSize> &words) noexcept {
+  const auto all = words.valid.words();
+  const auto &symbols = words.alphabet.symbols;
+  const uint32_t bits = symbol_bits(symbols.size());
+
+  std::vector<uint64_t> lanes(packed_lanes<kSize>(all.size(), bits));
+  uint64_t offset = 0;
+  for (const auto &word : all) {
+    for (const auto symbol : word) {
+      lanes[offset / 64] |= static_cast<uint64_t>(symbol) << (offset % 64);
+      if (offset % 64 + bits > 64) {
+        lanes[offset / 64 + 1] |=
+            static_cast<uint64_t>(symbol) >> (64 - offset % 64);
+      }
+      offset += bits;
+    }
+  }
+  std::vector<uint64_t> answers((all.size() + 63) / 64);
+  for (const auto index : words.possible.indexes()) {
+    answers[index / 64] |= UINT64_C(1) << (index % 64);
+  }
+
+  PackedHeader header{};
+  header.magic = kPackedMagic;
+  header.version = kPackedVersion;
+  header.size = kSize;
+  header.symbol_count = symbols.size();
+  header.symbol_bits = bits;
+  header.word_count = all.size();
+  header.answer_count = words.possible.size();
+  header.checksum = Cache::checksum(std::as_bytes(std::span(symbols)));
+  header.checksum = Cache::checksum(std::as_bytes(std::span(lanes)),
+                                    header.checksum);
+  header.checksum = Cache::checksum(std::as_bytes(std::span(answers)),
+                                    header.checksum);
+
+  const uint64_t symbols_end =
+      sizeof(PackedHeader) + symbols.size() * sizeof(char32_t);
+  const std::array<std::byte, sizeof(uint64_t)> padding{};
+  return Cache::replace(
+      filename, {std::as_bytes(std::span(&header, 1)),
+                 std::as_bytes(std::span(symbols)),
+                 std::span(padding).first(Cache::aligned(symbols_end) -
+                                          symbols_end),
+                 std::as_bytes(std::span(lanes)),
+                 std::as_bytes(std::span(answers))});
+}
+
+// words of a packed file, std::nullopt when missing, of another size or
+// corrupt
+template <std::size_t kSize>
+static inline std::optional<Words<kSize>>
+read_packed(const std::filesystem::path &filename) noexcept {
+  using word_type = Alphabet::word_type<kSize>;
+
+  const auto mapping = map(filename);
+  if (!mapping || mapping->bytes.size() < sizeof(PackedHeader)) {
+    return std::nullopt;
+  }
+  const auto *base = mapping->bytes.data();
+  PackedHeader header;
+  std::memcpy(&header, base, sizeof(PackedHeader));
+  if (header.magic != kPackedMagic || header.version != kPackedVersion ||
+      header.size != kSize || header.symbol_count >= Alphabet::kUnknown ||
+      header.symbol_bits != symbol_bits(header.symbol_count) ||
+      header.word_count > UINT32_MAX ||
+      header.answer_count > header.word_count) {
+    return std::nullopt;
+  }
+  const uint32_t bits = header.symbol_bits;
+  const uint64_t symbols_length = header.symbol_count * sizeof(char32_t);
+  const uint64_t lanes_offset =
+      Cache::aligned(sizeof(PackedHeader) + symbols_length);
+  const uint64_t lanes_length =
+      packed_lanes<kSize>(header.word_count, bits) * sizeof(uint64_t);
+  const uint64_t answers_offset = lanes_offset + lanes_length;
+  const uint64_t answers_length =
+      (header.word_count + 63) / 64 * sizeof(uint64_t);
+  if (answers_offset + answers_length != mapping->bytes.size()) {
+    return std::nullopt;
+  }
+  const auto bytes = std::as_bytes(std::span(base, mapping->bytes.size()));
+  uint64_t checksum =
+      Cache::checksum(bytes.subspan(sizeof(PackedHeader), symbols_length));
+  checksum = Cache::checksum(bytes.subspan(lanes_offset, lanes_length),
+                             checksum);
+  checksum = Cache::checksum(bytes.subspan(answers_offset, answers_length),
+                             checksum);
+  if (checksum != header.checksum) {
+    return std::nullopt;
+  }
+
+  Alphabet alphabet;
+  alphabet.symbols.resize(header.symbol_count);
+  std::memcpy(alphabet.symbols.data(), base + sizeof(PackedHeader),
+              symbols_length);
+
+  std::vector<word_type> words(header.word_count);
+  const auto *lanes = base + lanes_offset;
+  const uint64_t mask = (UINT64_C(1) << bits) - 1;
+  tbb::parallel_for(
+      tbb::blocked_range<size_t>(0, words.size()),
+      [&words, lanes, bits, mask](const tbb::blocked_range<size_t> &range) {
+        uint64_t offset = range.begin() * kSize * bits;
+        for (size_t index = range.begin(); index < range.end(); ++index) {
+          for (auto &symbol : words[index]) {
+            uint64_t lane;
+            std::memcpy(&lane, lanes + offset / 8, sizeof(lane));
+            symbol = static_cast<Alphabet::symbol_type>(
+                (lane >> (offset % 8)) & mask);
+            offset += bits;
+          }
+        }
+      });
+
+  std::vector<uint32_t> answers;
+  answers.reserve(header.answer_count);
+  for (uint64_t block = 0; block < answers_length / sizeof(uint64_t);
+       ++block) {
+    uint64_t flags;
+    std::memcpy(&flags, base + answers_offset + block * sizeof(uint64_t),
+                sizeof(flags));
+    for (; flags; flags &= flags - 1) {
+      answers.push_back(static_cast<uint32_t>(block * 64) +
+                        std::countr_zero(flags));
+    }
+  }
+  if (answers.size() != header.answer_count ||
+      (!answers.empty() && answers.back() >= words.size())) {
+    return std::nullopt;
+  }
+
+  auto storage = std::make_shared<const decltype(words)>(std::move(words));
+  return Words<kSize>{std::move(alphabet),
+                      WordList<kSize>(*storage, storage, std::move(answers)),
+                      WordList<kSize>(*storage, storage)};
+}
+
+// words of the dataset in directory, from its packed file unless a text
+// file is newer, else from the text files
+template <std::size_t kSize>
+static inline std::optional<Words<kSize>>
+load(const std::filesystem::path &directory) noexcept {
+  const auto possible = directory / kPossible;
+  const auto valid = directory / kValid;
+  const auto filename = packed<kSize>(directory);
+  std::error_code error;
+  const auto packed_time = std::filesystem::last_write_time(filename, error);
+  if (!error) {
+    bool fresh = true;
+    for (const auto &text : {possible, valid}) {
+      // a packed file may be shipped without its text files
+      const auto time = std::filesystem::last_write_time(text, error);
+      fresh = fresh && (error || time <= packed_time);
+    }
+    if (fresh) {
+      if (auto words = read_packed<kSize>(filename)) {
+        return words;
+      }
+    }
+  }
+  return read<kSize>(possible, valid);
+}
+
 } // namespace Dataset
@@ -0,0 +1,320 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Shen-Ta Hsieh
+
+#pragma once
+
+#include "cache.hpp"
+#include "context.hpp"
+#include "score.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string>
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <vector>
+
+// every answer of a dataset solved ahead of time by the greedy solver, each
+// node holds a guess and one edge per feedback pattern that does not end it
+template <std::size_t kSize> class DecisionTree {
+public:
+  using symbol_type = Alphabet::symbol_type;
+  using word_type = Alphabet::word_type<kSize>;
+
+  struct Node {
+    uint32_t guess;
+    uint32_t first_edge;
+    uint32_t edge_count;
+  };
+
+  // edges of a node are contiguous and sorted by pattern
+  struct Edge {
+    uint32_t pattern;
+    uint32_t node;
+  };
+
+  static inline constexpr const uint32_t kRoot = 0;
+
+  static inline std::optional<DecisionTree>
+  build(const Context<kSize> &context, bool hard_mode,
+        Score::Metric metric = Score::Metric::kExcluded) noexcept;
+
+  // cache file of the tree of a dataset
+  static std::optional<std::filesystem::path>
+  cache_filename(uint64_t dataset_hash, bool hard_mode,
+                 Score::Metric metric) noexcept {
+    std::string kind = "tree";
+    if (metric != Score::Metric::kExcluded) {
+      kind += '-';
+      kind += Score::name(metric);
+    }
+    if (hard_mode) {
+      kind += "-hard";
+    }
+    return Cache::filename<kSize>(dataset_hash, kind);
+  }
+
+  std::span<const symbol_type, kSize> guess(uint32_t node) const noexcept {
+    return words[nodes[node].guess];
+  }
+
+  // node to continue with after the guess of node got pattern, nullopt when
+  // no answer gives that pattern
+  std::optional<uint32_t> next(uint32_t node, uint64_t pattern) const noexcept {
+    const auto first = edges.begin() + nodes[node].first_edge;
+    const auto last = first + nodes[node].edge_count;
+    const auto it = std::lower_bound(
+        first, last, pattern, [](const Edge &edge, uint64_t pattern) noexcept {
+          return edge.pattern < pattern;
+        });
+    if (it == last || it->pattern != pattern) {
+      return std::nullopt;
+    }
+    return it->node;
+  }
+
+  double average_guesses() const noexcept {
+    return answer_count ? static_cast<double>(guess_total) /
+                              static_cast<double>(answer_count)
+                        : 0;
+  }
+
+  static inline std::optional<DecisionTree>
+  open(const std::filesystem::path &filename, uint64_t dataset_hash) noexcept;
+
+  inline bool save(const std::filesystem::path &filename,
+                   uint64_t dataset_hash) const noexcept;
+
+  Alphabet alphabet;
+  // guesses refer to these words, the valid input of the root context
+  std::vector<word_type> words;
+  std::vector<Node> nodes;
+  std::vector<Edge> edges;
+  bool hard_mode = false;
+  // guesses needed for the worst answer
+  uint32_t depth = 0;
+  uint64_t answer_count = 0;
+  // guesses needed for all answers together
+  uint64_t guess_total = 0;
+
+private:
+  static inline constexpr const std::array<char, 8> kMagic{
+      'W', 'O', 'R', 'D', 'L', 'E', 'D', 'T'};
+  static inline constexpr const uint32_t kVersion = 1;
+
+  struct Header {
+    std::array<char, 8> magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t hard_mode;
+    uint32_t symbol_count;
+    uint64_t dataset_hash;
+    uint64_t word_count;
+    uint64_t node_count;
+    uint64_t edge_count;
+    uint64_t depth;
+    uint64_t answer_count;
+    uint64_t guess_total;
+    uint64_t checksum;
+  };
+
+  // nodes and edges indexed from the subtree root
+  struct Subtree {
+    std::vector<Node> nodes;
+    std::vector<Edge> edges;
+    uint32_t depth = 0;
+    uint64_t answer_count = 0;
+    uint64_t guess_total = 0;
+  };
+
+  static inline std::optional<Subtree>
+  expand(const Context<kSize> &context, std::span<const word_type> words,
+         bool hard_mode, Score::Metric metric) noexcept;
+
+  uint64_t checksum() const noexcept {
+    uint64_t result =
+        Cache::checksum(std::as_bytes(std::span(alphabet.symbols)));
+    result = Cache::checksum(std::as_bytes(std::span(words)), result);
+    result = Cache::checksum(std::as_bytes(std::span(nodes)), result);
+    return Cache::checksum(std::as_bytes(std::span(edges)), result);
+  }
+};
+
+template <std::size_t kSize>
+std::optional<DecisionTree<kSize>>
+DecisionTree<kSize>::build(const Context<kSize> &context, bool hard_mode,
+                           Score::Metric metric) noexcept {
+  std::vector<word_type> words(context.valid_input.begin(),
+                               context.valid_input.end());
+  auto subtree = expand(context, words, hard_mode, metric);
+  if (!subtree) {
+    return std::nullopt;
+  }
+  DecisionTree tree;
+  tree.alphabet = context.alphabet;
+  tree.words = std::move(words);
+  tree.nodes = std::move(subtree->nodes);
+  tree.edges = std::move(subtree->edges);
+  tree.hard_mode = hard_mode;
+  tree.depth = subtree->depth;
+  tree.answer_count = subtree->answer_count;
+  tree.guess_total = subtree->guess_total;
+  return tree;
+}
+
+template <std::size_t kSize>
+std::optional<typename DecisionTree<kSize>::Subtree>
+DecisionTree<kSize>::expand(const Context<kSize> &context,
+                            std::span<const word_type> words,
+                            bool hard_mode, Score::Metric metric) noexcept {
+  const auto [score, candidate] = context.find_best_candidate(metric);
+  word_type guess;
+  std::copy(candidate.begin(), candidate.end(), guess.begin());
+  const auto word = std::lower_bound(words.begin(), words.end(), guess);
+  if (word == words.end() || *word != guess) {
+    return std::nullopt;
+  }
+
+  const auto answer_patterns = context.answer_patterns(guess);
+  std::vector<uint32_t> patterns(answer_patterns.begin(),
+                                 answer_patterns.end());
+  std::sort(patterns.begin(), patterns.end());
+  patterns.erase(std::unique(patterns.begin(), patterns.end()),
+                 patterns.end());
+  const bool solved = patterns.back() == Pattern::count<kSize> - 1;
+  if (solved) {
+    patterns.pop_back();
+  } else if (patterns.size() == 1) {
+    // the guess does not split the answers, recursing would never end
+    return std::nullopt;
+  }
+
+  std::vector<std::optional<Subtree>> children(patterns.size());
+  tbb::parallel_for(
+      tbb::blocked_range<size_t>(0, patterns.size()),
+      [&context, &words, hard_mode, metric, &guess, &patterns,
+       &children](const tbb::blocked_range<size_t> &range) noexcept {
+        for (size_t index = range.begin(); index != range.end(); ++index) {
+          auto child = context;
+          child.input_candidate(guess,
+                                Pattern::deserialize<kSize>(patterns[index]),
+                                hard_mode);
+          children[index] = expand(child, words, hard_mode, metric);
+        }
+      });
+
+  Subtree result;
+  result.nodes.push_back({static_cast<uint32_t>(
+                              std::distance(words.begin(), word)),
+                          0, static_cast<uint32_t>(patterns.size())});
+  result.edges.resize(patterns.size());
+  result.answer_count = context.possible_answer.size();
+  result.guess_total = solved ? 1 : 0;
+  for (size_t index = 0; index < patterns.size(); ++index) {
+    if (!children[index]) {
+      return std::nullopt;
+    }
+    const auto &child = *children[index];
+    const auto node_offset = static_cast<uint32_t>(result.nodes.size());
+    const auto edge_offset = static_cast<uint32_t>(result.edges.size());
+    result.edges[index] = {patterns[index], node_offset};
+    for (auto node : child.nodes) {
+      node.first_edge += edge_offset;
+      result.nodes.push_back(node);
+    }
+    for (auto edge : child.edges) {
+      edge.node += node_offset;
+      result.edges.push_back(edge);
+    }
+    result.depth = std::max(result.depth, child.depth);
+    // every answer below the child takes one more guess, the one made here
+    result.guess_total += child.guess_total + child.answer_count;
+  }
+  ++result.depth;
+  return result;
+}
+
+template <std::size_t kSize>
+std::optional<DecisionTree<kSize>>
+DecisionTree<kSize>::open(const std::filesystem::path &filename,
+                          uint64_t dataset_hash) noexcept {
+  std::ifstream file(filename, std::ios::binary);
+  if (!file) {
+    return std::nullopt;
+  }
+  Header header;
+  if (!file.read(reinterpret_cast<char *>(&header), sizeof(Header)) ||
+      header.magic != kMagic || header.version != kVersion ||
+      header.size != kSize || header.dataset_hash != dataset_hash ||
+      header.symbol_count >= Alphabet::kUnknown ||
+      header.word_count > UINT32_MAX || header.node_count > UINT32_MAX ||
+      header.edge_count > UINT32_MAX) {
+    return std::nullopt;
+  }
+  const uint64_t words_offset =
+      sizeof(Header) + header.symbol_count * sizeof(char32_t);
+  const uint64_t nodes_offset =
+      Cache::aligned(words_offset + header.word_count * sizeof(word_type));
+  const uint64_t length = nodes_offset + header.node_count * sizeof(Node) +
+                          header.edge_count * sizeof(Edge);
+  std::error_code error;
+  if (std::filesystem::file_size(filename, error) != length || error) {
+    return std::nullopt;
+  }
+
+  DecisionTree tree;
+  tree.alphabet.symbols.resize(header.symbol_count);
+  tree.words.resize(header.word_count);
+  tree.nodes.resize(header.node_count);
+  tree.edges.resize(header.edge_count);
+  file.read(reinterpret_cast<char *>(tree.alphabet.symbols.data()),
+            header.symbol_count * sizeof(char32_t));
+  file.read(reinterpret_cast<char *>(tree.words.data()),
+            header.word_count * sizeof(word_type));
+  file.seekg(nodes_offset);
+  file.read(reinterpret_cast<char *>(tree.nodes.data()),
+            header.node_count * sizeof(Node));
+  file.read(reinterpret_cast<char *>(tree.edges.data()),
+            header.edge_count * sizeof(Edge));
+  if (!file || tree.nodes.empty() || tree.checksum() != header.checksum) {
+    return std::nullopt;
+  }
+  tree.hard_mode = header.hard_mode != 0;
+  tree.depth = header.depth;
+  tree.answer_count = header.answer_count;
+  tree.guess_total = header.guess_total;
+  return tree;
+}
+
+template <std::size_t kSize>
+bool DecisionTree<kSize>::save(const std::filesystem::path &filename,
+                               uint64_t dataset_hash) const noexcept {
+  Header header{};
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.size = kSize;
+  header.hard_mode = hard_mode;
+  header.symbol_count = alphabet.symbols.size();
+  header.dataset_hash = dataset_hash;
+  header.word_count = words.size();
+  header.node_count = nodes.size();
+  header.edge_count = edges.size();
+  header.depth = depth;
+  header.answer_count = answer_count;
+  header.guess_total = guess_total;
+  header.checksum = checksum();
+
+  const auto symbols = std::as_bytes(std::span(alphabet.symbols));
+  const auto word_bytes = std::as_bytes(std::span(words));
+  const uint64_t offset = sizeof(Header) + symbols.size() + word_bytes.size();
+  const std::array<std::byte, sizeof(uint64_t)> padding{};
+  return Cache::replace(
+      filename, {std::as_bytes(std::span(&header, 1)), symbols, word_bytes,
+                 std::span(padding).first(Cache::aligned(offset) - offset),
+                 std::as_bytes(std::span(nodes)),
+                 std::as_bytes(std::span(edges))});
+}
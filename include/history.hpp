@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Shen-Ta Hsieh
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// linear undo history of game states, pushing a state drops the undone ones
+template <typename State> class History {
+public:
+  History() = default;
+  explicit History(State initial) noexcept { reset(std::move(initial)); }
+
+  void reset(State initial) noexcept {
+    states.clear();
+    states.push_back(std::move(initial));
+    position = 0;
+  }
+
+  bool empty() const noexcept { return states.empty(); }
+  const State &current() const noexcept { return states[position]; }
+
+  void push(State state) noexcept {
+    states.erase(states.begin() + position + 1, states.end());
+    states.push_back(std::move(state));
+    ++position;
+  }
+
+  bool can_undo() const noexcept { return position > 0; }
+  bool can_redo() const noexcept { return position + 1 < states.size(); }
+
+  bool undo() noexcept {
+    if (!can_undo()) {
+      return false;
+    }
+    --position;
+    return true;
+  }
+
+  bool redo() noexcept {
+    if (!can_redo()) {
+      return false;
+    }
+    ++position;
+    return true;
+  }
+
+private:
+  std::vector<State> states;
+  std::size_t position = 0;
+};
@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Shen-Ta Hsieh
+
+#pragma once
+#include "cache.hpp"
+#include "context.hpp"
+#include "dataset.hpp"
+#include "opening.hpp"
+#include "score.hpp"
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+
+// the dataset loading shared by the frontends, each one reports it its own way
+namespace Loader {
+
+template <std::size_t kSize> struct Loaded {
+  Context<kSize> context;
+  // of the word lists, std::nullopt when they can not be read
+  std::optional<uint64_t> hash;
+  // pattern matrix cache file, std::nullopt without a hash or a cache directory
+  std::optional<std::filesystem::path> cache;
+  // the pattern matrix came from cache, else the words were read and the
+  // matrix built if it fits in memory, then saved to cache
+  bool mapped = false;
+  bool saved = false;
+};
+
+template <std::size_t kSize>
+static inline std::optional<uint64_t>
+hash(const std::filesystem::path &directory) noexcept {
+  return Cache::hash<kSize>(
+      {directory / Dataset::kPossible, directory / Dataset::kValid});
+}
+
+// words of directory with their pattern matrix, std::nullopt when the words
+// can not be read or there is no answer
+template <std::size_t kSize>
+static inline std::optional<Loaded<kSize>>
+load(const std::filesystem::path &directory) noexcept {
+  Loaded<kSize> loaded;
+  auto &context = loaded.context;
+  // new games, undo and redo come back to answer sets solved before
+  context.solved_cache =
+      std::make_shared<typename Context<kSize>::SolvedCache>();
+  loaded.hash = hash<kSize>(directory);
+  loaded.cache =
+      loaded.hash ? Cache::filename<kSize>(*loaded.hash) : std::nullopt;
+  if (loaded.cache) {
+    if (auto matrix = Cache::open<kSize>(*loaded.cache, *loaded.hash)) {
+      context.use_pattern_matrix(std::move(matrix));
+      loaded.mapped = true;
+      return loaded;
+    }
+  }
+
+  auto words = Dataset::load<kSize>(directory);
+  if (!words || words->possible.empty()) {
+    return std::nullopt;
+  }
+  context.alphabet = std::move(words->alphabet);
+  context.possible_answer = std::move(words->possible);
+  context.valid_input = std::move(words->valid);
+  if (context.build_pattern_matrix() && loaded.cache) {
+    loaded.saved = Cache::save<kSize>(*loaded.cache, *loaded.hash,
+                                      *context.pattern_matrix);
+  }
+  return loaded;
+}
+
+// opening book of a dataset hash, only kept in memory without one
+template <std::size_t kSize>
+static inline Opening<kSize> opening(std::optional<uint64_t> hash,
+                                     bool hard_mode,
+                                     Score::Metric metric) noexcept {
+  return Opening<kSize>::open(
+      hash ? Opening<kSize>::cache_filename(*hash, hard_mode, metric)
+           : std::nullopt,
+      hash.value_or(0), hard_mode, metric);
+}
+
+} // namespace Loader
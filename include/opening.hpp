@@ -0,0 +1,243 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Shen-Ta Hsieh
+
+#pragma once
+
+#include "cache.hpp"
+#include "context.hpp"
+#include "progress.hpp"
+#include "score.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <span>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// best first guess of a dataset and the best second guess after each pattern
+// of it, the most expensive turns and the same on every launch, persisted
+// and filled as the turns are solved, one book per hard mode and metric
+template <std::size_t kSize> class Opening {
+public:
+  using symbol_type = Alphabet::symbol_type;
+  using word_type = Alphabet::word_type<kSize>;
+
+  // key of the first turn, the second turns are keyed by the first pattern
+  static inline constexpr const uint32_t kFirst = UINT32_MAX;
+
+  struct Entry {
+    uint32_t key;
+    double score;
+    word_type guess;
+  };
+
+  // the book stored in filename, empty when missing or stale, saved back to
+  // filename when it grows
+  static inline Opening
+  open(std::optional<std::filesystem::path> filename, uint64_t dataset_hash,
+       bool hard_mode,
+       Score::Metric metric = Score::Metric::kExcluded) noexcept;
+
+  // cache file of the book of a dataset
+  static std::optional<std::filesystem::path>
+  cache_filename(uint64_t dataset_hash, bool hard_mode,
+                 Score::Metric metric) noexcept {
+    std::string kind = "opening";
+    if (metric != Score::Metric::kExcluded) {
+      kind += '-';
+      kind += Score::name(metric);
+    }
+    if (hard_mode) {
+      kind += "-hard";
+    }
+    return Cache::filename<kSize>(dataset_hash, kind);
+  }
+
+  // key of the turn after word got pattern in the turn of key, nullopt once
+  // the game left the book
+  std::optional<uint32_t> next(std::optional<uint32_t> key,
+                               std::span<const symbol_type, kSize> word,
+                               uint64_t pattern,
+                               bool hard_mode) const noexcept {
+    if (key != kFirst || hard_mode != this->hard_mode) {
+      return std::nullopt;
+    }
+    const auto *first = find(kFirst);
+    if (!first ||
+        !std::equal(word.begin(), word.end(), first->guess.begin())) {
+      return std::nullopt;
+    }
+    return static_cast<uint32_t>(pattern);
+  }
+
+  // Context::find_best_candidate() of the book metric, served from the book
+  // for turns inside it
+  inline std::tuple<double, word_type>
+  find_best_candidate(const Context<kSize> &context,
+                      std::optional<uint32_t> key) noexcept {
+    return *best_candidate(context, key, nullptr);
+  }
+
+  // same while reporting to progress, std::nullopt once it is cancelled
+  inline std::optional<std::tuple<double, word_type>>
+  find_best_candidate(const Context<kSize> &context,
+                      std::optional<uint32_t> key,
+                      Progress &progress) noexcept {
+    return best_candidate(context, key, &progress);
+  }
+
+  const Entry *find(uint32_t key) const noexcept {
+    const auto it = std::lower_bound(
+        entries.begin(), entries.end(), key,
+        [](const Entry &entry, uint32_t key) noexcept {
+          return entry.key < key;
+        });
+    if (it == entries.end() || it->key != key) {
+      return nullptr;
+    }
+    return &*it;
+  }
+
+private:
+  inline std::optional<std::tuple<double, word_type>>
+  best_candidate(const Context<kSize> &context, std::optional<uint32_t> key,
+                 Progress *progress) noexcept;
+
+  static inline constexpr const std::array<char, 8> kMagic{
+      'W', 'O', 'R', 'D', 'L', 'E', 'O', 'B'};
+  static inline constexpr const uint32_t kVersion = 2;
+
+  struct Header {
+    std::array<char, 8> magic;
+    uint32_t version;
+    uint32_t size;
+    uint32_t hard_mode;
+    uint32_t metric;
+    uint64_t entry_count;
+    uint64_t dataset_hash;
+    uint64_t checksum;
+  };
+
+  inline bool save() const noexcept;
+
+  std::optional<std::filesystem::path> filename;
+  uint64_t dataset_hash = 0;
+  bool hard_mode = false;
+  Score::Metric metric = Score::Metric::kExcluded;
+  // sorted by key
+  std::vector<Entry> entries;
+};
+
+template <std::size_t kSize>
+Opening<kSize>
+Opening<kSize>::open(std::optional<std::filesystem::path> filename,
+                     uint64_t dataset_hash, bool hard_mode,
+                     Score::Metric metric) noexcept {
+  Opening opening;
+  opening.filename = std::move(filename);
+  opening.dataset_hash = dataset_hash;
+  opening.hard_mode = hard_mode;
+  opening.metric = metric;
+  if (!opening.filename) {
+    return opening;
+  }
+
+  std::ifstream file(*opening.filename, std::ios::binary);
+  Header header;
+  if (!file ||
+      !file.read(reinterpret_cast<char *>(&header), sizeof(Header)) ||
+      header.magic != kMagic || header.version != kVersion ||
+      header.size != kSize || header.hard_mode != hard_mode ||
+      header.metric != static_cast<uint32_t>(metric) ||
+      header.dataset_hash != dataset_hash ||
+      header.entry_count > Pattern::count<kSize>) {
+    return opening;
+  }
+  std::vector<double> scores(header.entry_count);
+  std::vector<uint32_t> keys(header.entry_count);
+  std::vector<word_type> guesses(header.entry_count);
+  file.read(reinterpret_cast<char *>(scores.data()),
+            scores.size() * sizeof(double));
+  file.read(reinterpret_cast<char *>(keys.data()),
+            keys.size() * sizeof(uint32_t));
+  file.read(reinterpret_cast<char *>(guesses.data()),
+            guesses.size() * sizeof(word_type));
+  uint64_t checksum = Cache::checksum(std::as_bytes(std::span(scores)));
+  checksum = Cache::checksum(std::as_bytes(std::span(keys)), checksum);
+  checksum = Cache::checksum(std::as_bytes(std::span(guesses)), checksum);
+  if (!file || file.peek() != std::ifstream::traits_type::eof() ||
+      checksum != header.checksum ||
+      !std::is_sorted(keys.begin(), keys.end())) {
+    return opening;
+  }
+  for (size_t index = 0; index < keys.size(); ++index) {
+    opening.entries.push_back({keys[index], scores[index], guesses[index]});
+  }
+  return opening;
+}
+
+template <std::size_t kSize>
+std::optional<std::tuple<double, typename Opening<kSize>::word_type>>
+Opening<kSize>::best_candidate(const Context<kSize> &context,
+                               std::optional<uint32_t> key,
+                               Progress *progress) noexcept {
+  if (key) {
+    if (const auto *entry = find(*key)) {
+      return std::tuple{entry->score, entry->guess};
+    }
+  }
+  const auto best = progress ? context.find_best_candidate(metric, *progress)
+                             : context.find_best_candidate(metric);
+  if (!best) {
+    return std::nullopt;
+  }
+  const auto [score, candidate] = *best;
+  word_type guess;
+  std::copy(candidate.begin(), candidate.end(), guess.begin());
+  if (key) {
+    entries.insert(std::lower_bound(entries.begin(), entries.end(), *key,
+                                    [](const Entry &entry,
+                                       uint32_t key) noexcept {
+                                      return entry.key < key;
+                                    }),
+                   {*key, score, guess});
+    save();
+  }
+  return std::tuple{score, guess};
+}
+
+template <std::size_t kSize> bool Opening<kSize>::save() const noexcept {
+  if (!filename) {
+    return false;
+  }
+  std::vector<double> scores;
+  std::vector<uint32_t> keys;
+  std::vector<word_type> guesses;
+  for (const auto &entry : entries) {
+    scores.push_back(entry.score);
+    keys.push_back(entry.key);
+    guesses.push_back(entry.guess);
+  }
+
+  Header header{};
+  header.magic = kMagic;
+  header.version = kVersion;
+  header.size = kSize;
+  header.hard_mode = hard_mode;
+  header.metric = static_cast<uint32_t>(metric);
+  header.entry_count = entries.size();
+  header.dataset_hash = dataset_hash;
+  header.checksum = Cache::checksum(std::as_bytes(std::span(scores)));
+  header.checksum =
+      Cache::checksum(std::as_bytes(std::span(keys)), header.checksum);
+  header.checksum =
+      Cache::checksum(std::as_bytes(std::span(guesses)), header.checksum);
+  return Cache::replace(*filename, {std::as_bytes(std::span(&header, 1)),
+                                    std::as_bytes(std::span(scores)),
+                                    std::as_bytes(std::span(keys)),
+                                    std::as_bytes(std::span(guesses))});
+}
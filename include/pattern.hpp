@@ -0,0 +1,280 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Shen-Ta Hsieh
+
+#pragma once
+
+#include "alphabet.hpp"
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <execution>
+#include <memory>
+#include <numeric>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+#if defined(__GNUC__) && defined(__x86_64__) && !defined(__EMSCRIPTEN__)
+// runtime dispatched clones, the default one is the baseline sse2 build
+#define WORDLE_TARGET_CLONES                                                   \
+  __attribute__((target_clones("default", "avx2", "avx512f")))
+#else
+// wasm simd128 and other targets rely on the compile flags alone
+#define WORDLE_TARGET_CLONES
+#endif
+
+namespace Pattern {
+
+#ifdef __EMSCRIPTEN__
+static inline constexpr const uint64_t kMatrixMemoryLimit = UINT64_C(16) << 20;
+#else
+static inline constexpr const uint64_t kMatrixMemoryLimit = UINT64_C(1) << 30;
+#endif
+
+static inline constexpr uint64_t power(uint64_t base,
+                                       uint64_t factor) noexcept {
+  uint64_t result = 1;
+  for (uint64_t index = 0; index < factor; ++index) {
+    result *= base;
+  }
+  return result;
+}
+
+template <std::size_t kSize>
+static inline constexpr const uint64_t count = power(3, kSize);
+
+// smallest unsigned integer able to hold a packed pattern
+template <std::size_t kSize>
+using type = std::conditional_t<
+    count<kSize> <= UINT64_C(0x100), uint8_t,
+    std::conditional_t<count<kSize> <= UINT64_C(0x10000), uint16_t, uint32_t>>;
+
+template <std::size_t kSize>
+static inline constexpr uint64_t
+serialize(std::span<const char8_t, kSize> result) noexcept {
+  return std::accumulate(result.begin(), result.end(), UINT64_C(0),
+                         [](uint64_t a, uint64_t b) constexpr noexcept {
+                           return a * UINT64_C(3) + b;
+                         });
+}
+
+template <std::size_t kSize>
+static inline constexpr std::array<char8_t, kSize>
+deserialize(uint64_t pattern) noexcept {
+  std::array<char8_t, kSize> result{};
+  for (size_t index = kSize; index-- > 0;) {
+    result[index] = static_cast<char8_t>(pattern % 3);
+    pattern /= 3;
+  }
+  return result;
+}
+
+using symbol_type = Alphabet::symbol_type;
+template <std::size_t kSize> using word_type = Alphabet::word_type<kSize>;
+
+// answers compared at once by calculate(), one byte lane per answer
+static inline constexpr const std::size_t kLanes = 32;
+
+// words transposed to one contiguous array per position, so one guess can be
+// compared against many words with plain vertical simd operations
+template <std::size_t kSize> class Columns {
+public:
+  Columns() = default;
+
+  // columns are padded by one block so a block starting at any word stays
+  // inside the buffer
+  explicit Columns(std::span<const word_type<kSize>> words) noexcept
+      : count(words.size()), stride(words.size() + kLanes),
+        symbols(kSize * stride) {
+    for (size_t index = 0; index < words.size(); ++index) {
+      for (size_t position = 0; position < kSize; ++position) {
+        symbols[position * stride + index] = words[index][position];
+      }
+    }
+  }
+
+  // the words at indexes of words, indexes ascending. answers are spread
+  // over the sorted union of a dataset, so they are gathered unless every
+  // valid input is an answer; valid_input is the whole union until hard mode
+  // filters it, and takes the contiguous path
+  Columns(std::span<const word_type<kSize>> words,
+          std::span<const uint32_t> indexes) noexcept {
+    if (indexes.empty() ||
+        indexes.back() - indexes.front() + 1 == indexes.size()) {
+      // a contiguous run transposes far faster than a gather
+      *this = Columns(words.subspan(indexes.empty() ? 0 : indexes.front(),
+                                    indexes.size()));
+      return;
+    }
+    count = indexes.size();
+    stride = indexes.size() + kLanes;
+    symbols.resize(kSize * stride);
+    auto *output = symbols.data();
+    for (size_t index = 0; index < indexes.size(); ++index) {
+      // a local copy, the byte stores below may alias anything else
+      const word_type<kSize> word = words[indexes[index]];
+      for (size_t position = 0; position < kSize; ++position) {
+        output[position * stride + index] = word[position];
+      }
+    }
+  }
+
+  std::size_t size() const noexcept { return count; }
+
+  const symbol_type *column(std::size_t position) const noexcept {
+    return symbols.data() + position * stride;
+  }
+
+private:
+  std::size_t count = 0;
+  std::size_t stride = 0;
+  std::vector<symbol_type> symbols;
+};
+
+// packed patterns of word against words [first, first + patterns.size()),
+// identical to serialize(Context::calculate(word, answer)) for each answer
+template <std::size_t kSize>
+WORDLE_TARGET_CLONES void calculate(std::span<const symbol_type, kSize> word,
+                                    const Columns<kSize> &answers,
+                                    std::size_t first,
+                                    std::span<type<kSize>> patterns) noexcept {
+  // generic vectors, lowered to whatever simd width the clone is built for
+  typedef symbol_type symbols_type __attribute__((vector_size(kLanes)));
+  typedef int8_t mask_type __attribute__((vector_size(kLanes)));
+  typedef type<kSize> patterns_type
+      __attribute__((vector_size(kLanes * sizeof(type<kSize>))));
+
+  std::array<const symbol_type *, kSize> columns;
+  for (size_t position = 0; position < kSize; ++position) {
+    columns[position] = answers.column(position) + first;
+  }
+  // earlier positions of word holding the same symbol
+  std::array<std::array<bool, kSize>, kSize> same{};
+  for (size_t index = 0; index < kSize; ++index) {
+    for (size_t before = 0; before < index; ++before) {
+      same[index][before] = word[index] == word[before];
+    }
+  }
+
+  for (size_t base = 0; base < patterns.size(); base += kLanes) {
+    std::array<symbols_type, kSize> symbols;
+    std::array<mask_type, kSize> missed;
+    for (size_t position = 0; position < kSize; ++position) {
+      __builtin_memcpy(&symbols[position], columns[position] + base,
+                       sizeof(symbols_type));
+      missed[position] = symbols[position] != word[position];
+    }
+    patterns_type pattern{};
+    for (size_t position = 0; position < kSize; ++position) {
+      // a missed symbol is yellow while the answer has more unmatched copies
+      // of it than earlier missed positions of word consumed, both counts are
+      // accumulated negated since true lanes are -1
+      mask_type remain{};
+      for (size_t other = 0; other < kSize; ++other) {
+        remain += missed[other] & (symbols[other] == word[position]);
+      }
+      mask_type consumed{};
+      for (size_t before = 0; before < position; ++before) {
+        if (same[position][before]) {
+          consumed += missed[before];
+        }
+      }
+      const mask_type yellow = remain < consumed;
+      const mask_type result =
+          (missed[position] & yellow & 1) | (~missed[position] & 2);
+      pattern = pattern * 3 + __builtin_convertvector(result, patterns_type);
+    }
+    const size_t lanes = std::min(kLanes, patterns.size() - base);
+    __builtin_memcpy(patterns.data() + base, &pattern,
+                     lanes * sizeof(type<kSize>));
+  }
+}
+
+// guess x answer table of packed patterns, rows are guesses
+template <std::size_t kSize> class Matrix {
+public:
+  using word_type = Pattern::word_type<kSize>;
+  using pattern_type = type<kSize>;
+
+  static inline constexpr uint64_t memory_usage(uint64_t guess_size,
+                                                uint64_t answer_size) noexcept {
+    return guess_size * answer_size * sizeof(pattern_type);
+  }
+
+  static std::shared_ptr<const Matrix>
+  build(Alphabet alphabet, std::vector<word_type> guesses,
+        std::vector<word_type> answers) noexcept {
+    struct Storage {
+      std::vector<word_type> guesses;
+      std::vector<word_type> answers;
+      std::vector<pattern_type> patterns;
+    };
+    auto storage = std::make_shared<Storage>();
+    storage->guesses = std::move(guesses);
+    storage->answers = std::move(answers);
+    storage->patterns.resize(storage->guesses.size() *
+                             storage->answers.size());
+    const Columns<kSize> columns(storage->answers);
+    std::vector<uint32_t> rows(storage->guesses.size());
+    std::iota(rows.begin(), rows.end(), 0);
+    std::for_each(std::execution::par, rows.begin(), rows.end(),
+                  [&storage, &columns](uint32_t guess) noexcept {
+                    calculate<kSize>(
+                        storage->guesses[guess], columns, 0,
+                        std::span(storage->patterns)
+                            .subspan(static_cast<std::size_t>(guess) *
+                                         storage->answers.size(),
+                                     storage->answers.size()));
+                  });
+
+    auto matrix = std::make_shared<Matrix>();
+    matrix->alphabet = std::move(alphabet);
+    matrix->guesses = storage->guesses;
+    matrix->answers = storage->answers;
+    matrix->patterns = storage->patterns;
+    matrix->storage = std::move(storage);
+    return matrix;
+  }
+
+  std::optional<uint32_t>
+  guess_index(std::span<const symbol_type, kSize> word) const noexcept {
+    return find(guesses, word);
+  }
+
+  std::optional<uint32_t>
+  answer_index(std::span<const symbol_type, kSize> word) const noexcept {
+    return find(answers, word);
+  }
+
+  std::span<const pattern_type> row(uint32_t guess) const noexcept {
+    return patterns.subspan(static_cast<std::size_t>(guess) * answers.size(),
+                            answers.size());
+  }
+
+  Alphabet alphabet;
+  std::span<const word_type> guesses;
+  std::span<const word_type> answers;
+  std::span<const pattern_type> patterns;
+  // owner of the memory viewed by the spans, a heap buffer or a file mapping
+  std::shared_ptr<const void> storage;
+
+private:
+  static std::optional<uint32_t>
+  find(std::span<const word_type> words,
+       std::span<const symbol_type, kSize> word) noexcept {
+    const auto it = std::lower_bound(
+        words.begin(), words.end(), word,
+        [](const word_type &a, std::span<const symbol_type, kSize> b) noexcept {
+          return std::lexicographical_compare(a.begin(), a.end(), b.begin(),
+                                              b.end());
+        });
+    if (it == words.end() || !std::equal(it->begin(), it->end(), word.begin(),
+                                         word.end())) {
+      return std::nullopt;
+    }
+    return static_cast<uint32_t>(std::distance(words.begin(), it));
+  }
+};
+
+} // namespace Pattern
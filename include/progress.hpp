@@ -0,0 +1,131 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Shen-Ta Hsieh
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <tbb/task_group.h>
+#include <tuple>
+#include <vector>
+
+// progress and cancellation of one long solver call, shared between the
+// solver running it and a frontend watching it from another thread
+//
+// the solver runs its parallel loops in group(), so cancel() stops them
+// between two words, and reports how many word steps are done and the best
+// guess so far. use a new one for every call, a cancelled group stays
+// cancelled
+class Progress {
+public:
+  using clock = std::chrono::steady_clock;
+
+  void cancel() noexcept { context.cancel_group_execution(); }
+  bool cancelled() const noexcept {
+    return context.is_group_execution_cancelled();
+  }
+  tbb::task_group_context &group() noexcept { return context; }
+
+  uint64_t done() const noexcept {
+    return done_count.load(std::memory_order_relaxed);
+  }
+  uint64_t total() const noexcept {
+    return total_count.load(std::memory_order_relaxed);
+  }
+  double fraction() const noexcept {
+    const uint64_t total = this->total();
+    return total ? static_cast<double>(done()) / static_cast<double>(total)
+                 : 0.0;
+  }
+
+  // word steps per second since start()
+  double rate() const noexcept {
+    const std::chrono::duration<double> elapsed =
+        clock::now() - clock::time_point(clock::duration(
+                           started.load(std::memory_order_relaxed)));
+    return elapsed.count() > 0 ? static_cast<double>(done()) / elapsed.count()
+                               : 0.0;
+  }
+
+  // value and valid_input index of the best guess scored so far, refined
+  // while the solver runs
+  std::optional<std::tuple<double, uint32_t>> best() const noexcept {
+    const Record *record = best_record.load(std::memory_order_acquire);
+    if (!record) {
+      return std::nullopt;
+    }
+    return std::tuple{record->value.load(std::memory_order_relaxed),
+                      record->index};
+  }
+
+  // solver side, a new pass of total word steps over guesses valid inputs
+  void start(uint64_t total, std::size_t guesses = 0) noexcept {
+    started.store(clock::now().time_since_epoch().count(),
+                  std::memory_order_relaxed);
+    done_count.store(0, std::memory_order_relaxed);
+    total_count.store(total, std::memory_order_relaxed);
+    best_record.store(nullptr, std::memory_order_release);
+    if (guesses <= record_count) {
+      return;
+    }
+    // a frontend may still read the best of an earlier pass, so smaller
+    // records are kept until the progress is gone
+    auto grown = std::make_unique<Record[]>(guesses);
+    for (std::size_t index = 0; index < guesses; ++index) {
+      grown[index].index = static_cast<uint32_t>(index);
+    }
+    records = grown.get();
+    record_count = guesses;
+    buffers.push_back(std::move(grown));
+  }
+
+  void advance(uint64_t count) noexcept {
+    done_count.fetch_add(count, std::memory_order_relaxed);
+  }
+
+  // the guess at index scored key, larger is better, shown as value. every
+  // guess is scored once a pass, so its record has a single writer and is
+  // published by swinging best_record to it. a later pass rewrites the
+  // record in place, a reader then sees the newer value of the same guess
+  void improve(uint64_t key, double value, uint32_t index) noexcept {
+    if (index >= record_count) {
+      return;
+    }
+    Record &record = records[index];
+    record.key.store(key, std::memory_order_relaxed);
+    record.value.store(value, std::memory_order_relaxed);
+    const Record *current = best_record.load(std::memory_order_acquire);
+    do {
+      if (current) {
+        const uint64_t best = current->key.load(std::memory_order_relaxed);
+        if (key < best || (key == best && index > current->index)) {
+          return;
+        }
+      }
+    } while (!best_record.compare_exchange_weak(current, &record,
+                                                std::memory_order_acq_rel,
+                                                std::memory_order_acquire));
+  }
+
+private:
+  struct Record {
+    std::atomic<uint64_t> key;
+    std::atomic<double> value;
+    uint32_t index;
+  };
+
+  // tbb asks for a mutable context even to read the cancellation
+  mutable tbb::task_group_context context;
+  std::atomic<clock::rep> started = 0;
+  std::atomic<uint64_t> done_count = 0;
+  std::atomic<uint64_t> total_count = 0;
+  std::vector<std::unique_ptr<Record[]>> buffers;
+  // the largest of buffers, written by start() only
+  Record *records = nullptr;
+  std::size_t record_count = 0;
+  std::atomic<const Record *> best_record = nullptr;
+};
@@ -0,0 +1,197 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Shen-Ta Hsieh
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// scoring policies of a guess by the sizes of the buckets its feedback
+// patterns split the answers into
+//
+// a policy folds the bucket sizes into an integer measure, add() one answer
+// at a time or buckets() a whole bucket at once, both starting from 0 and
+// never decreasing. key() turns a measure into a score where larger is
+// better and value() turns a score into the number shown to the user. the
+// solver relies on a measure never shrinking as answers are added and on an
+// even split being the smallest measure of a given answer count.
+namespace Score {
+
+using std::literals::string_view_literals::operator""sv;
+
+enum class Metric : uint32_t {
+  kExcluded,
+  kEntropy,
+  kExpected,
+  kMinimax,
+};
+
+static inline constexpr const std::array<std::string_view, 4> kNames{
+    "excluded"sv, "entropy"sv, "expected"sv, "minimax"sv};
+
+static inline constexpr std::string_view name(Metric metric) noexcept {
+  return kNames[static_cast<size_t>(metric)];
+}
+
+static inline constexpr std::optional<Metric>
+parse(std::string_view text) noexcept {
+  const auto it = std::find(kNames.begin(), kNames.end(), text);
+  if (it == kNames.end()) {
+    return std::nullopt;
+  }
+  return static_cast<Metric>(std::distance(kNames.begin(), it));
+}
+
+// answers excluded on average, plus one for a guess that may be the answer
+class Excluded {
+public:
+  explicit Excluded(uint64_t total) noexcept : total(total) {}
+
+  // measure after a bucket of count answers gets one more
+  uint64_t add(uint64_t measure, uint64_t count) const noexcept {
+    return measure + UINT64_C(2) * count + 1;
+  }
+
+  // measure after times more buckets of count answers
+  uint64_t buckets(uint64_t measure, uint64_t count,
+                   uint64_t times) const noexcept {
+    return measure + times * count * count;
+  }
+
+  uint64_t key(uint64_t square_sum, bool exact) const noexcept {
+    // sum of count * (total - count) over all buckets
+    uint64_t result = total * total - square_sum;
+    // exact bias
+    if (exact) {
+      ++result;
+    }
+    return result;
+  }
+
+  double value(uint64_t key) const noexcept {
+    return static_cast<double>(key) / static_cast<double>(total);
+  }
+
+protected:
+  uint64_t total;
+};
+
+// answers left on average, the plain version of Excluded without the bias
+// towards possible answers
+class Expected : public Excluded {
+public:
+  using Excluded::Excluded;
+
+  uint64_t key(uint64_t square_sum, bool) const noexcept {
+    return total * total - square_sum;
+  }
+
+  double value(uint64_t key) const noexcept {
+    return static_cast<double>(total * total - key) /
+           static_cast<double>(total);
+  }
+};
+
+// shannon entropy of the patterns in bits, plus 1 / total for a guess that
+// may be the answer. count * log2(count) is kept in 32 bit fixed point so
+// the measure is exact and the same in any summation order
+class Entropy {
+public:
+  explicit Entropy(uint64_t total) noexcept : table(total + 1) {
+    for (uint64_t count = 2; count <= total; ++count) {
+      table[count] = static_cast<uint64_t>(std::llround(
+          static_cast<double>(count) * std::log2(static_cast<double>(count)) *
+          static_cast<double>(kOne)));
+    }
+  }
+
+  uint64_t add(uint64_t measure, uint64_t count) const noexcept {
+    return measure + table[count + 1] - table[count];
+  }
+
+  uint64_t buckets(uint64_t measure, uint64_t count,
+                   uint64_t times) const noexcept {
+    return measure + times * table[count];
+  }
+
+  uint64_t key(uint64_t measure, bool exact) const noexcept {
+    return table.back() - measure + (exact ? kOne : 0);
+  }
+
+  double value(uint64_t key) const noexcept {
+    return static_cast<double>(key) /
+           static_cast<double>(table.size() - 1) / static_cast<double>(kOne);
+  }
+
+private:
+  static inline constexpr const uint64_t kOne = UINT64_C(1) << 32;
+
+  // count * log2(count) of every count up to total
+  std::vector<uint64_t> table;
+};
+
+// size of the largest bucket, the answers left in the worst case, ties go to
+// a guess that may be the answer
+class Minimax {
+public:
+  explicit Minimax(uint64_t total) noexcept : total(total) {}
+
+  uint64_t add(uint64_t largest, uint64_t count) const noexcept {
+    return std::max(largest, count + 1);
+  }
+
+  uint64_t buckets(uint64_t largest, uint64_t count,
+                   uint64_t times) const noexcept {
+    return times ? std::max(largest, count) : largest;
+  }
+
+  uint64_t key(uint64_t largest, bool exact) const noexcept {
+    return (total - largest) << 1 | (exact ? 1 : 0);
+  }
+
+  double value(uint64_t key) const noexcept {
+    return static_cast<double>(total - (key >> 1));
+  }
+
+private:
+  uint64_t total;
+};
+
+// function(std::type_identity<Policy>()) with the Policy of metric
+template <typename Function>
+static inline decltype(auto) visit(Metric metric,
+                                   Function &&function) noexcept {
+  switch (metric) {
+  case Metric::kEntropy:
+    return function(std::type_identity<Entropy>());
+  case Metric::kExpected:
+    return function(std::type_identity<Expected>());
+  case Metric::kMinimax:
+    return function(std::type_identity<Minimax>());
+  case Metric::kExcluded:
+    break;
+  }
+  return function(std::type_identity<Excluded>());
+}
+
+// Metric of Policy, the inverse of visit()
+template <typename Policy>
+static inline constexpr Metric metric_of() noexcept {
+  if constexpr (std::is_same_v<Policy, Entropy>) {
+    return Metric::kEntropy;
+  } else if constexpr (std::is_same_v<Policy, Expected>) {
+    return Metric::kExpected;
+  } else if constexpr (std::is_same_v<Policy, Minimax>) {
+    return Metric::kMinimax;
+  } else {
+    return Metric::kExcluded;
+  }
+}
+
+} // namespace Score
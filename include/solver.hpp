@@ -0,0 +1,98 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Shen-Ta Hsieh
+
+#pragma once
+
+#include "score.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// a game over the words of a size chosen at runtime, for programs embedding
+// the solver through the wordle_core library. words and patterns are utf-8
+// strings, a pattern has one digit per letter, 0 grey, 1 yellow and 2 green
+class Solver {
+public:
+  // the sizes a dataset may have
+  static inline constexpr const std::size_t kMinSize = 4;
+  static inline constexpr const std::size_t kMaxSize = 11;
+
+  struct Guess {
+    std::string word;
+    double score;
+  };
+
+  struct Candidate {
+    std::string word;
+    double score;
+    // whether the guess is one of the possible answers
+    bool possible;
+    // sizes of the buckets the guess splits the possible answers into,
+    // largest first
+    std::vector<uint32_t> buckets;
+  };
+
+  // the words of size code points in directory, with the pattern matrix
+  // mapped from the cache or built and saved there. std::nullopt for sizes
+  // outside kMinSize~kMaxSize or a dataset that cannot be read
+  static std::optional<Solver> load(const std::filesystem::path &directory,
+                                    std::size_t size) noexcept;
+
+  Solver(Solver &&) noexcept;
+  Solver &operator=(Solver &&) noexcept;
+  ~Solver();
+
+  // another game in the same state. the words, the pattern matrix and the
+  // cache of solved answer sets are shared, the game keeps only the indexes
+  // of the words left in every state of its history
+  Solver clone() const noexcept;
+
+  std::size_t size() const noexcept;
+  // possible answers left
+  std::size_t remaining() const noexcept;
+  bool is_finished() const noexcept;
+  std::vector<std::string> answers() const noexcept;
+  // the answer at index of those left, std::nullopt past the last
+  std::optional<std::string> answer(std::size_t index) const noexcept;
+
+  // best guess and its score by metric, std::nullopt once no answer is left
+  std::optional<Guess> best_guess(Score::Metric metric) const noexcept;
+
+  // the count best guesses by metric, best first
+  std::vector<Candidate> top_guesses(std::size_t count,
+                                     Score::Metric metric) const noexcept;
+
+  // guess with the fewest expected guesses to finish, looking depth guesses
+  // ahead over the width best guesses of metric, the score is that count
+  std::optional<Guess> lookahead_guess(std::size_t depth, std::size_t width,
+                                       Score::Metric metric) const noexcept;
+
+  // filters the answers by the pattern guess got, false and nothing filtered
+  // when guess is not size code points or pattern is malformed
+  bool input(std::string_view guess, std::string_view pattern,
+             bool hard_mode) noexcept;
+
+  // pattern guess gets against answer, std::nullopt when either is not size
+  // code points
+  std::optional<std::string> pattern(std::string_view guess,
+                                     std::string_view answer) const noexcept;
+
+  // steps through the inputs so far, false when there is none to step to
+  bool undo() noexcept;
+  bool redo() noexcept;
+  // back to every answer, forgetting the inputs
+  void reset() noexcept;
+
+private:
+  class Game;
+  template <std::size_t kSize> class Instance;
+
+  explicit Solver(std::unique_ptr<Game> game) noexcept;
+
+  std::unique_ptr<Game> game;
+};
@@ -0,0 +1,167 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Shen-Ta Hsieh
+
+#pragma once
+
+#include "alphabet.hpp"
+#include <algorithm>
+#include <compare>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <span>
+#include <vector>
+
+// a subset of an immutable word array, kept as indexes into it
+//
+// the indexes are immutable too, so copies share both and cost O(1), and
+// filtering makes a new index list while older copies keep theirs. an index
+// keeps naming the same word for as long as the array lives, so tables built
+// over the array stay valid
+template <std::size_t kSize> class WordList {
+public:
+  using word_type = Alphabet::word_type<kSize>;
+
+  class iterator {
+  public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = word_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const word_type *;
+    using reference = const word_type &;
+
+    iterator() = default;
+    iterator(const word_type *words, const uint32_t *index) noexcept
+        : words(words), index(index) {}
+
+    reference operator*() const noexcept { return words[*index]; }
+    pointer operator->() const noexcept { return &words[*index]; }
+    reference operator[](difference_type offset) const noexcept {
+      return words[index[offset]];
+    }
+
+    iterator &operator++() noexcept {
+      ++index;
+      return *this;
+    }
+    iterator operator++(int) noexcept { return {words, index++}; }
+    iterator &operator--() noexcept {
+      --index;
+      return *this;
+    }
+    iterator operator--(int) noexcept { return {words, index--}; }
+    iterator &operator+=(difference_type offset) noexcept {
+      index += offset;
+      return *this;
+    }
+    iterator &operator-=(difference_type offset) noexcept {
+      index -= offset;
+      return *this;
+    }
+    friend iterator operator+(iterator it, difference_type offset) noexcept {
+      return it += offset;
+    }
+    friend iterator operator+(difference_type offset, iterator it) noexcept {
+      return it += offset;
+    }
+    friend iterator operator-(iterator it, difference_type offset) noexcept {
+      return it -= offset;
+    }
+    friend difference_type operator-(const iterator &a,
+                                     const iterator &b) noexcept {
+      return a.index - b.index;
+    }
+    friend bool operator==(const iterator &a, const iterator &b) noexcept {
+      return a.index == b.index;
+    }
+    friend auto operator<=>(const iterator &a, const iterator &b) noexcept {
+      return a.index <=> b.index;
+    }
+
+  private:
+    const word_type *words = nullptr;
+    const uint32_t *index = nullptr;
+  };
+
+  WordList() = default;
+
+  // every word of words, in order
+  WordList(std::vector<word_type> words) noexcept {
+    auto storage = std::make_shared<const std::vector<word_type>>(
+        std::move(words));
+    all = *storage;
+    owner = std::move(storage);
+    reset();
+  }
+
+  // every word of words, kept alive by owner
+  WordList(std::span<const word_type> words,
+           std::shared_ptr<const void> owner) noexcept
+      : owner(std::move(owner)), all(words) {
+    reset();
+  }
+
+  // the words of words at indexes, ascending, kept alive by owner
+  WordList(std::span<const word_type> words, std::shared_ptr<const void> owner,
+           std::vector<uint32_t> indexes) noexcept
+      : owner(std::move(owner)), all(words),
+        list(std::make_shared<const std::vector<uint32_t>>(
+            std::move(indexes))) {}
+
+  std::size_t size() const noexcept { return list->size(); }
+  bool empty() const noexcept { return list->empty(); }
+  const word_type &operator[](std::size_t position) const noexcept {
+    return all[(*list)[position]];
+  }
+  const word_type &front() const noexcept { return all[list->front()]; }
+  iterator begin() const noexcept { return {all.data(), list->data()}; }
+  iterator end() const noexcept {
+    return {all.data(), list->data() + list->size()};
+  }
+
+  // the whole array the list indexes into
+  std::span<const word_type> words() const noexcept { return all; }
+  std::span<const uint32_t> indexes() const noexcept { return *list; }
+
+  // keep the words whose position in the list satisfies keep, returns the
+  // removed count
+  template <typename Predicate> uint64_t filter(Predicate &&keep) noexcept {
+    std::vector<uint32_t> kept;
+    kept.reserve(list->size());
+    for (size_t position = 0; position < list->size(); ++position) {
+      if (keep(position)) {
+        kept.push_back((*list)[position]);
+      }
+    }
+    const uint64_t removed = list->size() - kept.size();
+    list = std::make_shared<const std::vector<uint32_t>>(std::move(kept));
+    return removed;
+  }
+
+  // the words at positions of the list, positions ascending
+  WordList select(std::span<const uint32_t> positions) const noexcept {
+    std::vector<uint32_t> kept(positions.size());
+    std::transform(positions.begin(), positions.end(), kept.begin(),
+                   [this](uint32_t position) noexcept {
+                     return (*list)[position];
+                   });
+    WordList result = *this;
+    result.list =
+        std::make_shared<const std::vector<uint32_t>>(std::move(kept));
+    return result;
+  }
+
+  // back to every word of the array
+  void reset() noexcept {
+    std::vector<uint32_t> indexes(all.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    list = std::make_shared<const std::vector<uint32_t>>(std::move(indexes));
+  }
+
+private:
+  std::shared_ptr<const void> owner;
+  std::span<const word_type> all;
+  std::shared_ptr<const std::vector<uint32_t>> list =
+      std::make_shared<const std::vector<uint32_t>>();
+};
@@ -0,0 +1,93 @@
+/* SPDX-License-Identifier: MIT */
+/* SPDX-FileCopyrightText: 2022 Shen-Ta Hsieh */
+
+#pragma once
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef __GNUC__
+#define WORDLE_API __attribute__((visibility("default")))
+#else
+#define WORDLE_API
+#endif
+
+/* utf-8 bytes of the longest word, 11 code points, and its terminator */
+#define WORDLE_MAX_WORD_BYTES 45
+
+/* a game over a dataset. games cloned from one another share the words, the
+ * pattern matrix and the best guesses of answer sets solved before, a game
+ * keeps only the indexes of the words left. every call locks its game, so
+ * games may be used from any thread. a NULL game is WORDLE_INVALID, 0 or
+ * NULL, and ignored by wordle_free and wordle_reset */
+typedef struct wordle_game wordle_game;
+
+/* the metrics of wordle_solver --metric */
+enum wordle_metric {
+  WORDLE_EXCLUDED,
+  WORDLE_ENTROPY,
+  WORDLE_EXPECTED,
+  WORDLE_MINIMAX,
+};
+
+enum wordle_status {
+  WORDLE_OK,
+  /* a NULL game, or a malformed word, pattern or metric */
+  WORDLE_INVALID,
+  /* no answer is left */
+  WORDLE_NO_ANSWER,
+  /* the buffer is too small for the text and its terminator */
+  WORDLE_TOO_SMALL,
+};
+
+/* a new game over the words of size code points in the dataset directory,
+ * NULL when it cannot be read */
+WORDLE_API wordle_game *wordle_open_dataset(const char *directory,
+                                            size_t size);
+
+/* a new game in the same state as game, over the same dataset */
+WORDLE_API wordle_game *wordle_clone(const wordle_game *game);
+
+/* frees game, the dataset goes with the last game over it */
+WORDLE_API void wordle_free(wordle_game *game);
+
+/* code points of a word */
+WORDLE_API size_t wordle_word_size(const wordle_game *game);
+
+/* possible answers left */
+WORDLE_API size_t wordle_remaining(const wordle_game *game);
+
+/* writes the answer at index of those left into word */
+WORDLE_API enum wordle_status wordle_answer(const wordle_game *game,
+                                            size_t index, char *word,
+                                            size_t capacity);
+
+/* writes the best guess by metric into word, and its score into score unless
+ * it is NULL */
+WORDLE_API enum wordle_status wordle_best_guess(const wordle_game *game,
+                                                enum wordle_metric metric,
+                                                char *word, size_t capacity,
+                                                double *score);
+
+/* filters the answers by the pattern guess got, one digit per letter,
+ * 0 grey, 1 yellow and 2 green. in hard mode later guesses must fit it too */
+WORDLE_API enum wordle_status wordle_apply_feedback(wordle_game *game,
+                                                    const char *guess,
+                                                    const char *pattern,
+                                                    int hard_mode);
+
+/* writes the pattern guess gets against answer into pattern */
+WORDLE_API enum wordle_status wordle_pattern(const wordle_game *game,
+                                             const char *guess,
+                                             const char *answer,
+                                             char *pattern, size_t capacity);
+
+/* back to every answer */
+WORDLE_API void wordle_reset(wordle_game *game);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,333 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Shen-Ta Hsieh
+
+#include "context.hpp"
+#include "dataset.hpp"
+#include "score.hpp"
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <codecvt>
+#include <cstdlib>
+#include <locale>
+#include <spdlog/spdlog.h>
+#include <tbb/blocked_range.h>
+#include <tbb/global_control.h>
+#include <tbb/parallel_for.h>
+
+using std::literals::string_view_literals::operator""sv;
+
+namespace {
+
+// games needing more guesses than this are counted as failures
+static inline constexpr const std::size_t kMaxGuesses = 32;
+
+struct Options {
+  std::size_t word_size = 5;
+  std::string dataset = "wordle";
+  std::filesystem::path data_directory = Dataset::kData;
+  bool hard_mode = false;
+  bool pattern_matrix = true;
+  Score::Metric metric = Score::Metric::kExcluded;
+  std::size_t threads = 0;
+  // guesses searched ahead, greedy when 0
+  std::size_t lookahead = 0;
+  std::size_t width = 8;
+  // best guesses kept by answer set across games, none when 0
+  std::size_t cache = 0;
+};
+
+inline constexpr const auto kUsage =
+    "usage: wordle_solver_bench [--size 4~11] [--dataset name]\n"
+    "                           [--data-dir path] [--hard] [--no-matrix]\n"
+    "                           [--threads count]\n"
+    "                           [--metric excluded|entropy|expected|minimax]\n"
+    "                           [--lookahead depth] [--width count]\n"
+    "                           [--cache entries]"sv;
+
+// accumulated time of one solver phase over all threads
+class Phase {
+public:
+  explicit Phase(std::string_view name) noexcept : name(name) {}
+
+  template <typename Function> auto measure(Function &&function) noexcept {
+    const auto start = std::chrono::steady_clock::now();
+    auto result = function();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed)
+                       .count();
+    ++calls;
+    return result;
+  }
+
+  void report() const noexcept {
+    const double seconds = static_cast<double>(nanoseconds.load()) / 1e9;
+    spdlog::info("{:<22} {:>10.3f}s {:>10} calls {:>12.3f}ms/call"sv, name,
+                 seconds, calls.load(),
+                 calls ? seconds * 1e3 / static_cast<double>(calls) : 0.0);
+  }
+
+private:
+  std::string_view name;
+  std::atomic<uint64_t> nanoseconds = 0;
+  std::atomic<uint64_t> calls = 0;
+};
+
+template <std::size_t kSize>
+inline std::string
+to_utf8(const Alphabet &alphabet,
+        std::span<const Alphabet::symbol_type, kSize> word) noexcept {
+  const auto decoded = alphabet.decode<kSize>(word);
+  std::wstring_convert<std::codecvt_utf8_utf16<char32_t>, char32_t> converter;
+  return converter.to_bytes(decoded.data(), decoded.data() + decoded.size());
+}
+
+template <std::size_t kSize> bool run(const Options &options) noexcept {
+  Phase load("load"sv);
+  Phase matrix("build_pattern_matrix"sv);
+  Phase find("find_best_candidate"sv);
+  Phase input("input_candidate"sv);
+
+  const auto directory = options.data_directory / options.dataset;
+  const auto wall = std::chrono::steady_clock::now();
+  Context<kSize> initial;
+  if (!load.measure([&initial, &directory]() noexcept {
+        auto words = Dataset::load<kSize>(directory);
+        if (!words) {
+          return false;
+        }
+        initial.alphabet = std::move(words->alphabet);
+        initial.possible_answer = std::move(words->possible);
+        initial.valid_input = std::move(words->valid);
+        return true;
+      })) {
+    spdlog::error("load dataset `{}` failed"sv, directory.string());
+    return false;
+  }
+  if (options.pattern_matrix) {
+    matrix.measure(
+        [&initial]() noexcept { return initial.build_pattern_matrix(); });
+  }
+  if (options.cache) {
+    initial.solved_cache =
+        std::make_shared<typename Context<kSize>::SolvedCache>(options.cache);
+  }
+  spdlog::info("{} answers, {} guesses, pattern matrix {}"sv,
+               initial.possible_answer.size(), initial.valid_input.size(),
+               initial.pattern_matrix ? "on"sv : "off"sv);
+
+  // subproblems of the lookahead recur across games
+  typename Context<kSize>::Memo memo;
+  const auto find_candidate = [&options,
+                               &memo](const Context<kSize> &context) noexcept {
+    return options.lookahead
+               ? context.find_lookahead_candidate(
+                     options.lookahead, options.width, options.metric, &memo)
+               : context.find_best_candidate(options.metric);
+  };
+
+  // every game opens with the same guess, solve it once
+  const auto [opening_score, opening_candidate] =
+      find.measure([&initial, &find_candidate]() noexcept {
+        return find_candidate(initial);
+      });
+  typename Context<kSize>::word_type opening;
+  std::copy(opening_candidate.begin(), opening_candidate.end(),
+            opening.begin());
+
+  const auto &answers = initial.possible_answer;
+  std::vector<uint32_t> guesses(answers.size());
+  tbb::parallel_for(
+      tbb::blocked_range<size_t>(0, answers.size()),
+      [&options, &find, &input, &initial, &opening, &answers, &guesses,
+       &find_candidate](const tbb::blocked_range<size_t> &range) noexcept {
+        for (size_t index = range.begin(); index != range.end(); ++index) {
+          const auto &answer = answers[index];
+          auto context = initial;
+          auto guess = opening;
+          for (uint32_t turn = 1; turn <= kMaxGuesses; ++turn) {
+            const auto result = Context<kSize>::calculate(guess, answer);
+            if (Pattern::serialize<kSize>(result) ==
+                Pattern::count<kSize> - 1) {
+              guesses[index] = turn;
+              break;
+            }
+            input.measure([&context, &guess, &result, &options]() noexcept {
+              return context.input_candidate(guess, result, options.hard_mode);
+            });
+            if (context.possible_answer.empty()) {
+              break;
+            }
+            const auto [score, candidate] =
+                find.measure([&context, &find_candidate]() noexcept {
+                  return find_candidate(context);
+                });
+            std::copy(candidate.begin(), candidate.end(), guess.begin());
+          }
+        }
+      });
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - wall;
+
+  std::vector<uint64_t> histogram(kMaxGuesses + 1);
+  uint64_t total = 0;
+  uint64_t solved = 0;
+  for (const auto count : guesses) {
+    ++histogram[count];
+    if (count) {
+      total += count;
+      ++solved;
+    }
+  }
+  const auto worst =
+      std::distance(guesses.begin(),
+                    std::max_element(guesses.begin(), guesses.end()));
+
+  spdlog::info("opening `{}`, {} mode, {} metric"sv,
+               to_utf8<kSize>(initial.alphabet, opening),
+               options.hard_mode ? "hard"sv : "normal"sv,
+               Score::name(options.metric));
+  if (options.lookahead) {
+    spdlog::info("lookahead {} guesses over {} candidates, {} subproblems, "
+                 "{} hits, {} misses, {} evictions"sv,
+                 options.lookahead, options.width, memo.size(), memo.hits(),
+                 memo.misses(), memo.evictions());
+  }
+  if (const auto &cache = initial.solved_cache) {
+    spdlog::info("solved cache {}/{} entries, {} hits, {} misses, "
+                 "{} evictions"sv,
+                 cache->size(), cache->capacity(), cache->hits(),
+                 cache->misses(), cache->evictions());
+  }
+  for (size_t count = 1; count <= kMaxGuesses; ++count) {
+    if (histogram[count]) {
+      spdlog::info("{:>2} guesses: {}"sv, count, histogram[count]);
+    }
+  }
+  spdlog::info("mean {:.4f} guesses, worst {} guesses for `{}`"sv,
+               solved ? static_cast<double>(total) / solved : 0.0,
+               guesses.empty() ? 0 : guesses[worst],
+               guesses.empty() ? std::string()
+                               : to_utf8<kSize>(initial.alphabet,
+                                                answers[worst]));
+  spdlog::info("failures: {}"sv, histogram[0]);
+  load.report();
+  matrix.report();
+  find.report();
+  input.report();
+  spdlog::info("wall time {:.3f}s"sv, elapsed.count());
+  return histogram[0] == 0;
+}
+
+bool run(const Options &options) noexcept {
+  switch (options.word_size) {
+  default:
+    spdlog::error("unsupported size `{}`! need 4~11"sv, options.word_size);
+    return false;
+  case 4:
+    return run<4>(options);
+  case 5:
+    return run<5>(options);
+  case 6:
+    return run<6>(options);
+  case 7:
+    return run<7>(options);
+  case 8:
+    return run<8>(options);
+  case 9:
+    return run<9>(options);
+  case 10:
+    return run<10>(options);
+  case 11:
+    return run<11>(options);
+  }
+}
+
+std::optional<std::size_t> parse_number(std::string_view text) noexcept {
+  std::size_t value;
+  const auto [last, error] =
+      std::from_chars(text.data(), text.data() + text.size(), value);
+  if (error != std::errc() || last != text.data() + text.size()) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+std::optional<Options> parse_options(int argc, char *argv[]) noexcept {
+  Options options;
+  for (int index = 1; index < argc; ++index) {
+    const std::string_view flag = argv[index];
+    if (flag == "--hard"sv) {
+      options.hard_mode = true;
+      continue;
+    }
+    if (flag == "--no-matrix"sv) {
+      options.pattern_matrix = false;
+      continue;
+    }
+    if (index + 1 == argc) {
+      spdlog::error("missing value of `{}`"sv, flag);
+      return std::nullopt;
+    }
+    const std::string_view value = argv[++index];
+    if (flag == "--size"sv) {
+      if (const auto size = parse_number(value)) {
+        options.word_size = *size;
+        continue;
+      }
+    } else if (flag == "--threads"sv) {
+      if (const auto threads = parse_number(value)) {
+        options.threads = *threads;
+        continue;
+      }
+    } else if (flag == "--cache"sv) {
+      if (const auto cache = parse_number(value)) {
+        options.cache = *cache;
+        continue;
+      }
+    } else if (flag == "--lookahead"sv) {
+      if (const auto depth = parse_number(value)) {
+        options.lookahead = *depth;
+        continue;
+      }
+    } else if (flag == "--width"sv) {
+      if (const auto width = parse_number(value); width && *width) {
+        options.width = *width;
+        continue;
+      }
+    } else if (flag == "--metric"sv) {
+      if (const auto metric = Score::parse(value)) {
+        options.metric = *metric;
+        continue;
+      }
+    } else if (flag == "--dataset"sv) {
+      options.dataset = value;
+      continue;
+    } else if (flag == "--data-dir"sv) {
+      options.data_directory = value;
+      continue;
+    } else {
+      spdlog::error("unknown flag `{}`"sv, flag);
+      return std::nullopt;
+    }
+    spdlog::error("invalid value `{}` of `{}`"sv, value, flag);
+    return std::nullopt;
+  }
+  return options;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) noexcept {
+  const auto options = parse_options(argc, argv);
+  if (!options) {
+    spdlog::info("{}"sv, kUsage);
+    return EXIT_FAILURE;
+  }
+  std::optional<tbb::global_control> threads;
+  if (options->threads != 0) {
+    threads.emplace(tbb::global_control::max_allowed_parallelism,
+                    options->threads);
+  }
+  return run(*options) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,110 @@
+/* SPDX-License-Identifier: MIT */
+/* SPDX-FileCopyrightText: 2022 Shen-Ta Hsieh */
+
+/* solves answers of a dataset through the c api, one clone of the opened
+ * game per thread, and checks every answer is found */
+
+#include "wordle.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define THREADS 4
+/* a game taking more guesses has gone wrong */
+#define MAX_TURNS 32
+
+struct worker {
+  /* answers of the opened game, shared by every worker */
+  const wordle_game *answers;
+  size_t count;
+  /* the worker plays answers first, first + THREADS and so on */
+  size_t first;
+  wordle_game *game;
+  size_t guesses;
+  int failed;
+};
+
+static void *play(void *argument) {
+  struct worker *worker = argument;
+  char answer[WORDLE_MAX_WORD_BYTES];
+  char guess[WORDLE_MAX_WORD_BYTES];
+  char pattern[WORDLE_MAX_WORD_BYTES];
+  for (size_t index = worker->first; index < worker->count;
+       index += THREADS) {
+    if (wordle_answer(worker->answers, index, answer, sizeof(answer)) !=
+        WORDLE_OK) {
+      worker->failed = 1;
+      return NULL;
+    }
+    wordle_reset(worker->game);
+    size_t turn = 1;
+    for (;; ++turn) {
+      if (turn > MAX_TURNS ||
+          wordle_best_guess(worker->game, WORDLE_EXCLUDED, guess,
+                            sizeof(guess), NULL) != WORDLE_OK ||
+          wordle_pattern(worker->game, guess, answer, pattern,
+                         sizeof(pattern)) != WORDLE_OK) {
+        fprintf(stderr, "failed to solve `%s`\n", answer);
+        worker->failed = 1;
+        return NULL;
+      }
+      if (strcmp(guess, answer) == 0) {
+        break;
+      }
+      wordle_apply_feedback(worker->game, guess, pattern, 0);
+    }
+    worker->guesses += turn;
+  }
+  return NULL;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: wordle_capi_demo directory size [count]\n");
+    return EXIT_FAILURE;
+  }
+  wordle_game *game = wordle_open_dataset(argv[1], strtoul(argv[2], NULL, 10));
+  if (!game) {
+    fprintf(stderr, "open dataset `%s` failed\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+  size_t count = wordle_remaining(game);
+  if (argc > 3 && strtoul(argv[3], NULL, 10) < count) {
+    count = strtoul(argv[3], NULL, 10);
+  }
+  printf("%zu answers of %zu letters\n", wordle_remaining(game),
+         wordle_word_size(game));
+
+  struct worker workers[THREADS];
+  pthread_t threads[THREADS];
+  int failed = 0;
+  size_t started = 0;
+  for (; started < THREADS; ++started) {
+    workers[started] = (struct worker){game, count, started,
+                                       wordle_clone(game), 0, 0};
+    if (!workers[started].game ||
+        pthread_create(&threads[started], NULL, play, &workers[started]) !=
+            0) {
+      fprintf(stderr, "start worker %zu failed\n", started);
+      /* the workers already started still read the game */
+      wordle_free(workers[started].game);
+      failed = 1;
+      break;
+    }
+  }
+  size_t guesses = 0;
+  for (size_t index = 0; index < started; ++index) {
+    pthread_join(threads[index], NULL);
+    failed |= workers[index].failed;
+    guesses += workers[index].guesses;
+    wordle_free(workers[index].game);
+  }
+  wordle_free(game);
+  if (failed) {
+    return EXIT_FAILURE;
+  }
+  printf("solved %zu answers, %f guesses on average\n", count,
+         count ? (double)guesses / (double)count : 0.0);
+  return EXIT_SUCCESS;
+}
@@ -3,18 +3,65 @@
 
 #include "context.hpp"
 #include "dataset.hpp"
+#include "decision_tree.hpp"
+#include "history.hpp"
+#include "loader.hpp"
+#include "opening.hpp"
+#include "score.hpp"
+#include <charconv>
+#include <chrono>
+#include <codecvt>
+#include <csignal>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <locale>
+#include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/spdlog.h>
+#include <tbb/global_control.h>
+#include <tbb/parallel_for.h>
+#include <variant>
 
 #ifdef __EMSCRIPTEN__
 #include <emscripten.h>
+#else
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 #endif
 
 using std::literals::string_view_literals::operator""sv;
 
 namespace {
 
+// greedy guesses searched at every step of --lookahead
+static inline constexpr const std::size_t kLookaheadWidth = 8;
+
+enum class Mode {
+  kSolve,
+  kServe,
+  kBuildTree,
+  kLookupTree,
+};
+
+enum class Edit {
+  kUndo,
+  kRedo,
+};
+
+inline constexpr std::string_view edit_name(Edit edit) noexcept {
+  return edit == Edit::kUndo ? "undo"sv : "redo"sv;
+}
+
+template <typename State>
+inline bool apply(History<State> &history, Edit edit) noexcept {
+  return edit == Edit::kUndo ? history.undo() : history.redo();
+}
+
 std::string read_input(std::string_view message) noexcept {
   spdlog::info("{}"sv, message);
   std::string buffer;
@@ -28,6 +75,19 @@ inline std::string to_utf8(std::span<const char32_t, kSize> word) noexcept {
   return converter.to_bytes(word.data(), word.data() + word.size());
 }
 
+inline std::u32string from_utf8(std::string_view text) noexcept {
+  std::wstring_convert<std::codecvt_utf8_utf16<char32_t>, char32_t> converter(
+      "", U"");
+  return converter.from_bytes(text.data(), text.data() + text.size());
+}
+
+template <std::size_t kSize>
+inline std::string
+to_utf8(const Alphabet &alphabet,
+        std::span<const Alphabet::symbol_type, kSize> word) noexcept {
+  return to_utf8<kSize>(alphabet.decode<kSize>(word));
+}
+
 inline constexpr bool invalid_character(char char_) noexcept {
   switch (char_) {
   case '0':
@@ -39,11 +99,19 @@ inline constexpr bool invalid_character(char char_) noexcept {
   }
 }
 
-template <std::size_t kSize> std::array<char8_t, kSize> ask_result() noexcept {
+// a result, or an edit of the results entered so far
+template <std::size_t kSize>
+std::variant<std::array<char8_t, kSize>, Edit> ask_result() noexcept {
   std::array<char8_t, kSize> parsed_result{};
   do {
-    std::string result =
-        read_input("please enter result(0:grey, 1:yello, 2:green):"sv);
+    std::string result = read_input(
+        "please enter result(0:grey, 1:yello, 2:green) or undo, redo:"sv);
+    if (result == "undo"sv) {
+      return Edit::kUndo;
+    }
+    if (result == "redo"sv) {
+      return Edit::kRedo;
+    }
     if (result.size() != kSize) {
       spdlog::error("result size not match:{} != {}"sv, result.size(), kSize);
       continue;
@@ -75,34 +143,133 @@ template <std::size_t kSize> std::array<char8_t, kSize> ask_result() noexcept {
 }
 
 template <std::size_t kSize>
-bool run(const std::filesystem::path &directory, bool hard_mode) noexcept {
-  Context<kSize> context;
-  if (auto set = Dataset::read<kSize>(Dataset::kData / directory /
-                                      Dataset::kPossible)) {
-    context.possible_answer = std::move(*set);
-    spdlog::info("read problem words set, {} words"sv,
-                 context.possible_answer.size());
-  } else {
-    return false;
+std::optional<std::filesystem::path>
+tree_filename(const std::filesystem::path &directory, bool hard_mode,
+              Score::Metric metric) noexcept {
+  const auto hash = Loader::hash<kSize>(directory);
+  if (!hash) {
+    return std::nullopt;
   }
+  return DecisionTree<kSize>::cache_filename(*hash, hard_mode, metric);
+}
 
-  if (auto set =
-          Dataset::read<kSize>(Dataset::kData / directory / Dataset::kValid)) {
-    context.valid_input = std::move(*set);
-    spdlog::info("read all words set, {} words"sv, context.valid_input.size());
-  } else {
+template <std::size_t kSize>
+Opening<kSize> open_opening(const std::filesystem::path &directory,
+                            bool hard_mode, Score::Metric metric) noexcept {
+  return Loader::opening<kSize>(Loader::hash<kSize>(directory), hard_mode,
+                                metric);
+}
+
+template <std::size_t kSize>
+bool load(Context<kSize> &context,
+          const std::filesystem::path &directory) noexcept {
+  auto loaded = Loader::load<kSize>(directory);
+  if (!loaded) {
     return false;
   }
+  context = std::move(loaded->context);
+  if (loaded->mapped) {
+    spdlog::info("mapped pattern matrix cache `{}`, {}x{} patterns"sv,
+                 loaded->cache->string(), context.valid_input.size(),
+                 context.possible_answer.size());
+    return true;
+  }
+
+  spdlog::info("read problem words set, {} words"sv,
+               context.possible_answer.size());
+  spdlog::info("read all words set, {} words"sv, context.valid_input.size());
+  spdlog::info("alphabet of {} symbols"sv, context.alphabet.symbols.size());
+  if (context.pattern_matrix) {
+    spdlog::info("built pattern matrix, {}x{} patterns"sv,
+                 context.pattern_matrix->guesses.size(),
+                 context.pattern_matrix->answers.size());
+  }
+  if (loaded->saved) {
+    spdlog::info("saved pattern matrix cache `{}`"sv, loaded->cache->string());
+  }
+  return true;
+}
 
-  context.reorder_all_word_set();
+template <std::size_t kSize>
+bool solve(const std::filesystem::path &directory, bool hard_mode,
+           Score::Metric metric, std::size_t top,
+           std::size_t lookahead) noexcept {
+  Context<kSize> context;
+  if (!load(context, directory)) {
+    return false;
+  }
+  typename Context<kSize>::Memo memo;
 
-  while (!context.is_finished()) {
-    const auto [excluded, candidate] = context.find_best_candidate();
-    spdlog::info("`{}` exclude {} words"sv, to_utf8(candidate), excluded);
+  auto opening = open_opening<kSize>(directory, hard_mode, metric);
+  struct Turn {
+    typename Context<kSize>::Snapshot snapshot;
+    std::optional<uint32_t> key;
+  };
+  History<Turn> history(Turn{context.snapshot(), Opening<kSize>::kFirst});
+  while (context.possible_answer.size() != 1) {
+    // a mistyped result can rule out every answer, wait for an undo then
+    const bool stuck = context.possible_answer.empty();
+    typename Context<kSize>::word_type candidate{};
+    if (stuck) {
+      spdlog::info("no answer founded! undo to take back a result"sv);
+    } else {
+      const auto key = history.current().key;
+      std::vector<typename Context<kSize>::Candidate> candidates;
+      if (lookahead) {
+        const auto [expected, best] = context.find_lookahead_candidate(
+            lookahead, kLookaheadWidth, metric, &memo);
+        std::copy(best.begin(), best.end(), candidate.begin());
+        spdlog::info("`{}` {} expected guesses"sv,
+                     to_utf8<kSize>(context.alphabet, candidate), expected);
+      } else if (top && !(key && opening.find(*key))) {
+        // the ranking comes out of the same search as the guess
+        candidates = context.find_top_candidates(top, metric);
+        const auto &best = candidates.front();
+        std::copy(best.word.begin(), best.word.end(), candidate.begin());
+        spdlog::info("`{}` {} {}"sv,
+                     to_utf8<kSize>(context.alphabet, candidate),
+                     Score::name(metric), best.score);
+      } else {
+        const auto [score, best] = opening.find_best_candidate(context, key);
+        candidate = best;
+        spdlog::info("`{}` {} {}"sv,
+                     to_utf8<kSize>(context.alphabet, candidate),
+                     Score::name(metric), score);
+      }
+      if (top && candidates.empty()) {
+        candidates = context.find_top_candidates(top, metric);
+      }
+      for (size_t rank = 0; rank < candidates.size(); ++rank) {
+        const auto &ranked = candidates[rank];
+        spdlog::info("{:>3}. `{}` {} {} buckets, largest {}{}"sv, rank + 1,
+                     to_utf8<kSize>(context.alphabet, ranked.word),
+                     ranked.score, ranked.buckets.size(),
+                     ranked.buckets.front(),
+                     ranked.possible ? ", possible answer"sv : ""sv);
+      }
+    }
 
-    const auto result = ask_result<kSize>();
+    const auto input = ask_result<kSize>();
+    if (const auto *edit = std::get_if<Edit>(&input)) {
+      if (apply(history, *edit)) {
+        context.restore(history.current().snapshot);
+        spdlog::info("{}, {} candidates"sv, edit_name(*edit),
+                     context.possible_answer.size());
+      } else {
+        spdlog::error("nothing to {}"sv, edit_name(*edit));
+      }
+      continue;
+    }
+    if (stuck) {
+      continue;
+    }
+    const auto &result = std::get<std::array<char8_t, kSize>>(input);
     const auto [possible_answer_removed, possible_answer_remained] =
         context.input_candidate(candidate, result, hard_mode);
+    history.push({context.snapshot(),
+                  opening.next(history.current().key, candidate,
+                               Pattern::serialize<kSize>(result),
+                               hard_mode)});
     spdlog::info("removed {}, remained {} candidates"sv,
                  possible_answer_removed, possible_answer_remained);
 
@@ -110,50 +277,702 @@ bool run(const std::filesystem::path &directory, bool hard_mode) noexcept {
       std::string wordlist;
       for (const auto &word : context.possible_answer) {
         wordlist += ' ';
-        wordlist += to_utf8<kSize>(word);
+        wordlist += to_utf8<kSize>(context.alphabet, word);
       }
       spdlog::info("candidates:{}"sv, wordlist);
     }
   }
 
-  if (context.possible_answer.size() == 1) {
-    spdlog::info("final answer: `{}`"sv,
-                 to_utf8<kSize>(context.possible_answer.front()));
+  spdlog::info("final answer: `{}`"sv,
+               to_utf8<kSize>(context.alphabet,
+                              context.possible_answer.front()));
+  return true;
+}
+
+std::optional<std::size_t> parse_number(std::string_view text) noexcept {
+  std::size_t value;
+  const auto [last, error] =
+      std::from_chars(text.data(), text.data() + text.size(), value);
+  if (error != std::errc() || last != text.data() + text.size()) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+// parse a `guess pattern` line of the serve protocol
+template <std::size_t kSize>
+std::optional<
+    std::tuple<std::array<char32_t, kSize>, std::array<char8_t, kSize>>>
+parse_turn(std::string_view line) noexcept {
+  const auto space = line.find(' ');
+  if (space == std::string_view::npos) {
+    return std::nullopt;
+  }
+  const auto guess = from_utf8(line.substr(0, space));
+  const auto pattern = line.substr(space + 1);
+  if (guess.size() != kSize || pattern.size() != kSize ||
+      std::any_of(pattern.begin(), pattern.end(), invalid_character)) {
+    return std::nullopt;
+  }
+  std::tuple<std::array<char32_t, kSize>, std::array<char8_t, kSize>> turn;
+  std::copy(guess.begin(), guess.end(), std::get<0>(turn).begin());
+  std::transform(pattern.begin(), pattern.end(), std::get<1>(turn).begin(),
+                 [](char char_) noexcept {
+                   return static_cast<char8_t>(char_ - '0');
+                 });
+  return turn;
+}
+
+// the serve protocol over the games of one loaded dataset, a game is only
+// the history of its turns. every turn keeps its reply, so undo and redo
+// answer without solving
+template <std::size_t kSize> class Protocol {
+public:
+  struct Turn {
+    typename Context<kSize>::Snapshot snapshot;
+    std::optional<uint32_t> key;
+    std::string reply;
+  };
+
+  Protocol(Context<kSize> initial, Opening<kSize> opening, bool hard_mode,
+           Score::Metric metric) noexcept
+      : initial(std::move(initial)), opening(std::move(opening)),
+        hard_mode(hard_mode), metric(metric) {
+    const auto [score, candidate] = this->opening.find_best_candidate(
+        this->initial, Opening<kSize>::kFirst);
+    first_turn = {this->initial.snapshot(), Opening<kSize>::kFirst,
+                  reply(this->initial, candidate)};
+  }
+
+  const Turn &first() const noexcept { return first_turn; }
+
+  // the reply to line in the game of history. when concurrent, the opening
+  // book is only read and turns outside it are left to the solved cache, so
+  // different games can be answered from many threads at once
+  std::string answer(History<Turn> &history, std::string_view line,
+                     bool concurrent) noexcept {
+    if (line == "reset"sv) {
+      history.reset(first_turn);
+      return first_turn.reply;
+    }
+    if (line == "undo"sv || line == "redo"sv) {
+      const auto edit = line == "undo"sv ? Edit::kUndo : Edit::kRedo;
+      if (!apply(history, edit)) {
+        return "error nothing to " + std::string(edit_name(edit));
+      }
+      return history.current().reply;
+    }
+    const auto turn = parse_turn<kSize>(line);
+    if (!turn) {
+      return "error invalid line `" + std::string(line) + '`';
+    }
+    const auto &[guess, result] = *turn;
+    auto context = initial;
+    context.restore(history.current().snapshot);
+    const auto word = context.alphabet.template encode<kSize>(guess);
+    context.input_candidate(word, result, hard_mode);
+    Turn next{context.snapshot(),
+              opening.next(history.current().key, word,
+                           Pattern::serialize<kSize>(result), hard_mode),
+              "- 0"};
+    if (!context.possible_answer.empty()) {
+      const auto *entry = next.key ? opening.find(*next.key) : nullptr;
+      if (entry) {
+        next.reply = reply(context, entry->guess);
+      } else if (concurrent) {
+        const auto [score, candidate] = context.find_best_candidate(metric);
+        next.reply = reply(context, candidate);
+      } else {
+        const auto [score, candidate] =
+            opening.find_best_candidate(context, next.key);
+        next.reply = reply(context, candidate);
+      }
+    }
+    history.push(std::move(next));
+    return history.current().reply;
+  }
+
+private:
+  static std::string
+  reply(const Context<kSize> &context,
+        std::span<const Alphabet::symbol_type, kSize> candidate) noexcept {
+    return to_utf8<kSize>(context.alphabet, candidate) + ' ' +
+           std::to_string(context.possible_answer.size());
+  }
+
+  Context<kSize> initial;
+  Opening<kSize> opening;
+  bool hard_mode;
+  Score::Metric metric;
+  Turn first_turn;
+};
+
+#ifndef __EMSCRIPTEN__
+// set by SIGINT and SIGTERM to stop listening
+volatile std::sig_atomic_t g_Stopped = 0;
+// written by the same signals to wake up poll(), a signal caught between
+// checking g_Stopped and polling would otherwise wait for the next event
+int g_StopPipe[2] = {-1, -1};
+
+// a connection longer than this without a line break is closed
+static inline constexpr const std::size_t kMaxLine = 4096;
+// replies buffered for a peer that does not read, its lines wait past it
+static inline constexpr const std::size_t kMaxOutput = 4 * kMaxLine;
+
+// a game of the serve protocol on a connection
+template <std::size_t kSize> struct Connection {
+  Connection(int fd, typename Protocol<kSize>::Turn first) noexcept
+      : fd(fd), history(std::move(first)) {}
+
+  int fd;
+  History<typename Protocol<kSize>::Turn> history;
+  // bytes after the last line break read
+  std::string input;
+  // lines read and not answered yet
+  std::vector<std::string> lines;
+  // replies not written yet
+  std::string output;
+  // the peer sent everything, close once the replies are written
+  bool finished = false;
+  bool failed = false;
+};
+
+// a listening socket, on 127.0.0.1 for a port number and a unix domain
+// socket at any other address, -1 on failure
+int listen_on(const std::string &address) noexcept {
+  int fd = -1;
+  if (const auto port = parse_number(address); port && *port <= UINT16_MAX) {
+    fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    sockaddr_in name{};
+    name.sin_family = AF_INET;
+    name.sin_port = htons(static_cast<uint16_t>(*port));
+    name.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    const int reuse = 1;
+    if (fd < 0 ||
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse)) < 0 ||
+        bind(fd, reinterpret_cast<const sockaddr *>(&name), sizeof(name)) <
+            0) {
+      spdlog::error("listen on port {} failed: {}"sv, *port,
+                    std::strerror(errno));
+      if (fd >= 0) {
+        close(fd);
+      }
+      return -1;
+    }
   } else {
-    spdlog::info("no answer founded!"sv);
+    sockaddr_un name{};
+    name.sun_family = AF_UNIX;
+    if (address.size() >= sizeof(name.sun_path)) {
+      spdlog::error("socket path `{}` too long"sv, address);
+      return -1;
+    }
+    std::copy(address.begin(), address.end(), name.sun_path);
+    std::error_code error;
+    if (std::filesystem::is_socket(address, error)) {
+      // only a socket left by a server that did not stop cleanly refuses
+      // connections, a live server keeps its address
+      fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      const bool live =
+          fd >= 0 && connect(fd, reinterpret_cast<const sockaddr *>(&name),
+                             sizeof(name)) == 0;
+      const int reason = live ? EADDRINUSE : errno;
+      if (fd >= 0) {
+        close(fd);
+      }
+      if (reason != ECONNREFUSED) {
+        spdlog::error("listen on `{}` failed: {}"sv, address,
+                      std::strerror(reason));
+        return -1;
+      }
+      std::filesystem::remove(address, error);
+    }
+    fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 ||
+        bind(fd, reinterpret_cast<const sockaddr *>(&name), sizeof(name)) <
+            0) {
+      spdlog::error("listen on `{}` failed: {}"sv, address,
+                    std::strerror(errno));
+      if (fd >= 0) {
+        close(fd);
+      }
+      return -1;
+    }
+  }
+  if (listen(fd, SOMAXCONN) < 0 || fcntl(fd, F_SETFL, O_NONBLOCK) < 0) {
+    spdlog::error("listen on `{}` failed: {}"sv, address,
+                  std::strerror(errno));
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+// reads what connection has sent and splits it into lines
+template <std::size_t kSize>
+void receive(Connection<kSize> &connection) noexcept {
+  std::array<char, 4096> buffer;
+  while (true) {
+    const auto size = read(connection.fd, buffer.data(), buffer.size());
+    if (size > 0) {
+      connection.input.append(buffer.data(), size);
+      continue;
+    }
+    if (size == 0) {
+      connection.finished = true;
+    } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+      connection.failed = true;
+    }
+    break;
+  }
+  std::size_t first = 0;
+  for (auto last = connection.input.find('\n'); last != std::string::npos;
+       last = connection.input.find('\n', first)) {
+    auto line = std::string_view(connection.input).substr(first, last - first);
+    if (!line.empty() && line.back() == '\r') {
+      line.remove_suffix(1);
+    }
+    connection.lines.emplace_back(line);
+    first = last + 1;
+  }
+  connection.input.erase(0, first);
+  if (connection.input.size() > kMaxLine) {
+    connection.failed = true;
+  }
+}
+
+// writes the replies of connection as far as the socket takes them
+template <std::size_t kSize>
+void flush(Connection<kSize> &connection) noexcept {
+  std::size_t written = 0;
+  while (written < connection.output.size()) {
+    const auto size =
+        send(connection.fd, connection.output.data() + written,
+             connection.output.size() - written, MSG_NOSIGNAL);
+    if (size > 0) {
+      written += size;
+      continue;
+    }
+    if (size < 0 && errno != EAGAIN && errno != EWOULDBLOCK &&
+        errno != EINTR) {
+      connection.failed = true;
+    }
+    break;
+  }
+  connection.output.erase(0, written);
+}
+
+// the serve protocol for many games at once, one per connection to address.
+// the lines read in a round of poll() are answered as one batch in parallel,
+// the games sharing the loaded dataset, its pattern matrix and solved cache
+template <std::size_t kSize>
+bool serve_connections(Protocol<kSize> &protocol,
+                       const std::string &address) noexcept {
+  const int listener = listen_on(address);
+  if (listener < 0) {
+    return false;
+  }
+  if (pipe2(g_StopPipe, O_CLOEXEC | O_NONBLOCK) < 0) {
+    spdlog::error("create pipe failed: {}"sv, std::strerror(errno));
+    close(listener);
+    return false;
+  }
+  struct sigaction action {};
+  action.sa_handler = [](int) {
+    const int saved = errno;
+    g_Stopped = 1;
+    const char byte = 0;
+    if (write(g_StopPipe[1], &byte, 1) < 0) {
+      // the pipe is full, poll() wakes up already
+    }
+    errno = saved;
+  };
+  sigaction(SIGINT, &action, nullptr);
+  sigaction(SIGTERM, &action, nullptr);
+  spdlog::info("listening on `{}`"sv, address);
+
+  std::vector<Connection<kSize>> connections;
+  std::vector<pollfd> fds;
+  std::vector<Connection<kSize> *> batch;
+  // off while out of file descriptors, until a connection closes
+  bool accepting = true;
+  while (!g_Stopped) {
+    fds.clear();
+    fds.push_back({listener, static_cast<short>(accepting ? POLLIN : 0), 0});
+    fds.push_back({g_StopPipe[0], POLLIN, 0});
+    bool answerable = false;
+    for (const auto &connection : connections) {
+      // nothing is read from a peer that has sent everything, or while its
+      // lines read before wait for it to read the replies
+      const bool reading = !connection.finished && connection.lines.empty() &&
+                           connection.output.size() < kMaxOutput;
+      fds.push_back({connection.fd,
+                     static_cast<short>(
+                         (reading ? POLLIN : 0) |
+                         (connection.output.empty() ? 0 : POLLOUT)),
+                     0});
+      // lines left over once the replies are written
+      answerable = answerable || (!connection.lines.empty() &&
+                                  connection.output.size() < kMaxOutput);
+    }
+    if (poll(fds.data(), fds.size(), answerable ? 0 : -1) < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      spdlog::error("poll failed: {}"sv, std::strerror(errno));
+      break;
+    }
+
+    batch.clear();
+    for (std::size_t index = 0; index < connections.size(); ++index) {
+      auto &connection = connections[index];
+      const auto revents = fds[index + 2].revents;
+      if (revents & (POLLHUP | POLLERR)) {
+        // replies can no longer be delivered
+        connection.failed = true;
+        continue;
+      }
+      if (revents & POLLIN) {
+        receive(connection);
+      }
+      if (!connection.lines.empty() &&
+          connection.output.size() < kMaxOutput) {
+        batch.push_back(&connection);
+      }
+    }
+    tbb::parallel_for(std::size_t(0), batch.size(),
+                      [&protocol, &batch](std::size_t index) noexcept {
+                        auto &connection = *batch[index];
+                        auto line = connection.lines.begin();
+                        for (; line != connection.lines.end() &&
+                               connection.output.size() < kMaxOutput;
+                             ++line) {
+                          connection.output +=
+                              protocol.answer(connection.history, *line, true);
+                          connection.output += '\n';
+                        }
+                        connection.lines.erase(connection.lines.begin(), line);
+                      });
+    for (auto &connection : connections) {
+      flush(connection);
+    }
+    if (std::erase_if(connections, [](const Connection<kSize> &connection) {
+          const bool closed =
+              connection.failed ||
+              (connection.finished && connection.lines.empty() &&
+               connection.output.empty());
+          if (closed) {
+            close(connection.fd);
+          }
+          return closed;
+        })) {
+      accepting = true;
+    }
+
+    if (fds.front().revents & POLLIN) {
+      int fd;
+      while ((fd = accept4(listener, nullptr, nullptr,
+                           SOCK_CLOEXEC | SOCK_NONBLOCK)) >= 0) {
+        auto &connection = connections.emplace_back(fd, protocol.first());
+        connection.output = protocol.first().reply + '\n';
+        flush(connection);
+      }
+      if (errno == EMFILE || errno == ENFILE) {
+        spdlog::error("out of file descriptors at {} connections"sv,
+                      connections.size());
+        accepting = false;
+      }
+    }
+  }
+
+  for (const auto &connection : connections) {
+    close(connection.fd);
+  }
+  close(listener);
+  for (auto &fd : g_StopPipe) {
+    close(fd);
+    fd = -1;
+  }
+  if (!parse_number(address)) {
+    std::error_code error;
+    std::filesystem::remove(address, error);
+  }
+  spdlog::info("stopped, {} connections closed"sv, connections.size());
+  return true;
+}
+#endif
+
+// line protocol for other processes: every `guess pattern` line on stdin is
+// answered by `suggestion remaining` on stdout, `reset` starts a new game.
+// with an address the games of many connections are served instead
+template <std::size_t kSize>
+bool serve(const std::filesystem::path &directory, bool hard_mode,
+           Score::Metric metric, const std::string &address) noexcept {
+#ifdef __EMSCRIPTEN__
+  if (!address.empty()) {
+    spdlog::error("`--listen` is not supported here"sv);
+    return false;
+  }
+#endif
+  Context<kSize> initial;
+  if (!load(initial, directory)) {
+    return false;
+  }
+  Protocol<kSize> protocol(std::move(initial),
+                           open_opening<kSize>(directory, hard_mode, metric),
+                           hard_mode, metric);
+#ifndef __EMSCRIPTEN__
+  if (!address.empty()) {
+    return serve_connections(protocol, address);
+  }
+#endif
+  std::cout << protocol.first().reply << std::endl;
+
+  History<typename Protocol<kSize>::Turn> history(protocol.first());
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    std::cout << protocol.answer(history, line, false) << std::endl;
   }
+  return true;
+}
+
+template <std::size_t kSize>
+bool build_tree(const std::filesystem::path &directory, bool hard_mode,
+                Score::Metric metric) noexcept {
+  Context<kSize> context;
+  if (!load(context, directory)) {
+    return false;
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  const auto tree = DecisionTree<kSize>::build(context, hard_mode, metric);
+  const std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  if (!tree) {
+    spdlog::error("build decision tree failed"sv);
+    return false;
+  }
+  spdlog::info("built decision tree in {:.3f}s, {} nodes"sv, elapsed.count(),
+               tree->nodes.size());
+  spdlog::info("depth {}, {:.4f} guesses on average over {} answers"sv,
+               tree->depth, tree->average_guesses(), tree->answer_count);
+
+  const auto hash = Loader::hash<kSize>(directory);
+  const auto filename = tree_filename<kSize>(directory, hard_mode, metric);
+  if (!filename || !tree->save(*filename, *hash)) {
+    spdlog::error("save decision tree failed"sv);
+    return false;
+  }
+  spdlog::info("saved decision tree `{}`"sv, filename->string());
+  return true;
+}
 
+template <std::size_t kSize>
+bool lookup_tree(const std::filesystem::path &directory, bool hard_mode,
+                 Score::Metric metric) noexcept {
+  const auto hash = Loader::hash<kSize>(directory);
+  const auto filename = tree_filename<kSize>(directory, hard_mode, metric);
+  const auto tree = filename ? DecisionTree<kSize>::open(*filename, *hash)
+                             : std::nullopt;
+  if (!tree) {
+    spdlog::error("no decision tree for this dataset, build it first"sv);
+    return false;
+  }
+  spdlog::info("opened decision tree `{}`, depth {}, {:.4f} guesses on "
+               "average"sv,
+               filename->string(), tree->depth, tree->average_guesses());
+
+  History<uint32_t> history(DecisionTree<kSize>::kRoot);
+  while (true) {
+    const auto guess = tree->guess(history.current());
+    spdlog::info("`{}`"sv, to_utf8<kSize>(tree->alphabet, guess));
+
+    const auto input = ask_result<kSize>();
+    if (const auto *edit = std::get_if<Edit>(&input)) {
+      if (!apply(history, *edit)) {
+        spdlog::error("nothing to {}"sv, edit_name(*edit));
+      }
+      continue;
+    }
+    const auto pattern = Pattern::serialize<kSize>(
+        std::get<std::array<char8_t, kSize>>(input));
+    if (pattern == Pattern::count<kSize> - 1) {
+      spdlog::info("final answer: `{}`"sv,
+                   to_utf8<kSize>(tree->alphabet, guess));
+      break;
+    }
+    if (const auto next = tree->next(history.current(), pattern)) {
+      history.push(*next);
+    } else {
+      // no answer gives this pattern, most likely a typo
+      spdlog::error("no answer founded! undo or enter the result again"sv);
+    }
+  }
   return true;
 }
 
+template <std::size_t kSize>
+bool run(const std::filesystem::path &directory, bool hard_mode,
+         Score::Metric metric, Mode mode, std::size_t top,
+         std::size_t lookahead, const std::string &address) noexcept {
+  switch (mode) {
+  case Mode::kSolve:
+    return solve<kSize>(directory, hard_mode, metric, top, lookahead);
+  case Mode::kServe:
+    return serve<kSize>(directory, hard_mode, metric, address);
+  case Mode::kBuildTree:
+    return build_tree<kSize>(directory, hard_mode, metric);
+  case Mode::kLookupTree:
+    return lookup_tree<kSize>(directory, hard_mode, metric);
+  }
+  return false;
+}
+
 bool run(std::size_t word_size, const std::filesystem::path &directory,
-         bool hard_mode) noexcept {
+         bool hard_mode, Score::Metric metric, Mode mode, std::size_t top,
+         std::size_t lookahead, const std::string &address) noexcept {
   switch (word_size) {
   default:
     spdlog::error("unsupported size `{}`! need 4~11"sv, word_size);
     return false;
   case 4:
-    return run<4>(directory, hard_mode);
+    return run<4>(directory, hard_mode, metric, mode, top, lookahead, address);
   case 5:
-    return run<5>(directory, hard_mode);
+    return run<5>(directory, hard_mode, metric, mode, top, lookahead, address);
   case 6:
-    return run<6>(directory, hard_mode);
+    return run<6>(directory, hard_mode, metric, mode, top, lookahead, address);
   case 7:
-    return run<7>(directory, hard_mode);
+    return run<7>(directory, hard_mode, metric, mode, top, lookahead, address);
   case 8:
-    return run<8>(directory, hard_mode);
+    return run<8>(directory, hard_mode, metric, mode, top, lookahead, address);
   case 9:
-    return run<9>(directory, hard_mode);
+    return run<9>(directory, hard_mode, metric, mode, top, lookahead, address);
   case 10:
-    return run<10>(directory, hard_mode);
+    return run<10>(directory, hard_mode, metric, mode, top, lookahead, address);
   case 11:
-    return run<11>(directory, hard_mode);
+    return run<11>(directory, hard_mode, metric, mode, top, lookahead, address);
+  }
+}
+
+struct Options {
+  std::size_t word_size = 5;
+  std::string dataset = "wordle";
+  std::filesystem::path data_directory = Dataset::kData;
+  bool hard_mode = false;
+  Score::Metric metric = Score::Metric::kExcluded;
+  std::size_t threads = 0;
+  Mode mode = Mode::kServe;
+  // ranked guesses listed by solve
+  std::size_t top = 0;
+  // guesses solve searches ahead, greedy when 0
+  std::size_t lookahead = 0;
+  // port or unix socket path serve listens on, stdin when empty
+  std::string listen;
+};
+
+inline constexpr const auto kUsage =
+    "usage: wordle_solver [--size 4~11] [--dataset name] [--data-dir path]\n"
+    "                     [--hard] [--threads count]\n"
+    "                     [--metric excluded|entropy|expected|minimax]\n"
+    "                     [--mode serve|solve|build-tree|lookup-tree]\n"
+    "                     [--top count] [--lookahead depth]\n"
+    "                     [--listen port|path]"sv;
+
+std::optional<Options> parse_options(int argc, char *argv[]) noexcept {
+  Options options;
+  for (int index = 1; index < argc; ++index) {
+    const std::string_view flag = argv[index];
+    if (flag == "--hard"sv) {
+      options.hard_mode = true;
+      continue;
+    }
+    if (index + 1 == argc) {
+      spdlog::error("missing value of `{}`"sv, flag);
+      return std::nullopt;
+    }
+    const std::string_view value = argv[++index];
+    if (flag == "--size"sv) {
+      if (const auto size = parse_number(value)) {
+        options.word_size = *size;
+        continue;
+      }
+    } else if (flag == "--threads"sv) {
+      if (const auto threads = parse_number(value)) {
+        options.threads = *threads;
+        continue;
+      }
+    } else if (flag == "--top"sv) {
+      if (const auto top = parse_number(value)) {
+        options.top = *top;
+        continue;
+      }
+    } else if (flag == "--lookahead"sv) {
+      if (const auto depth = parse_number(value)) {
+        options.lookahead = *depth;
+        continue;
+      }
+    } else if (flag == "--dataset"sv) {
+      options.dataset = value;
+      continue;
+    } else if (flag == "--listen"sv) {
+      options.listen = value;
+      continue;
+    } else if (flag == "--data-dir"sv) {
+      options.data_directory = value;
+      continue;
+    } else if (flag == "--metric"sv) {
+      if (const auto metric = Score::parse(value)) {
+        options.metric = *metric;
+        continue;
+      }
+    } else if (flag == "--mode"sv) {
+      if (value == "serve"sv) {
+        options.mode = Mode::kServe;
+        continue;
+      } else if (value == "solve"sv) {
+        options.mode = Mode::kSolve;
+        continue;
+      } else if (value == "build-tree"sv) {
+        options.mode = Mode::kBuildTree;
+        continue;
+      } else if (value == "lookup-tree"sv) {
+        options.mode = Mode::kLookupTree;
+        continue;
+      }
+    } else {
+      spdlog::error("unknown flag `{}`"sv, flag);
+      return std::nullopt;
+    }
+    spdlog::error("invalid value `{}` of `{}`"sv, value, flag);
+    return std::nullopt;
   }
+  return options;
 }
 
 } // namespace
 
-int main() noexcept {
+int main(int argc, char *argv[]) noexcept {
+  if (argc > 1) {
+    // stdout belongs to the serve protocol
+    spdlog::set_default_logger(spdlog::stderr_color_st("stderr"));
+    const auto options = parse_options(argc, argv);
+    if (!options) {
+      spdlog::info("{}"sv, kUsage);
+      return EXIT_FAILURE;
+    }
+    std::optional<tbb::global_control> threads;
+    if (options->threads != 0) {
+      threads.emplace(tbb::global_control::max_allowed_parallelism,
+                      options->threads);
+    }
+    std::ios::sync_with_stdio(false);
+    return run(options->word_size,
+               options->data_directory / options->dataset,
+               options->hard_mode, options->metric, options->mode,
+               options->top, options->lookahead, options->listen)
+               ? EXIT_SUCCESS
+               : EXIT_FAILURE;
+  }
+
   size_t word_size;
   do {
     try {
@@ -229,7 +1048,62 @@ int main() noexcept {
       spdlog::error("out of range:{}"sv, msg.what());
     }
   } while (true);
-  if (run(word_size, directory, hard_mode)) {
+
+  Score::Metric metric = Score::Metric::kExcluded;
+  do {
+    try {
+      switch (std::stoul(read_input("please enter metric:\n"
+                                    "1.excluded\n"
+                                    "2.entropy\n"
+                                    "3.expected\n"
+                                    "4.minimax"sv))) {
+      case 1:
+        metric = Score::Metric::kExcluded;
+        break;
+      case 2:
+        metric = Score::Metric::kEntropy;
+        break;
+      case 3:
+        metric = Score::Metric::kExpected;
+        break;
+      case 4:
+        metric = Score::Metric::kMinimax;
+        break;
+      }
+      break;
+    } catch (std::invalid_argument &msg) {
+      spdlog::error("invalid argument:{}"sv, msg.what());
+    } catch (std::out_of_range &msg) {
+      spdlog::error("out of range:{}"sv, msg.what());
+    }
+  } while (true);
+
+  Mode mode = Mode::kSolve;
+  do {
+    try {
+      switch (std::stoul(read_input("please enter mode:\n"
+                                    "1.solve\n"
+                                    "2.build decision tree\n"
+                                    "3.lookup decision tree"sv))) {
+      case 1:
+        mode = Mode::kSolve;
+        break;
+      case 2:
+        mode = Mode::kBuildTree;
+        break;
+      case 3:
+        mode = Mode::kLookupTree;
+        break;
+      }
+      break;
+    } catch (std::invalid_argument &msg) {
+      spdlog::error("invalid argument:{}"sv, msg.what());
+    } catch (std::out_of_range &msg) {
+      spdlog::error("out of range:{}"sv, msg.what());
+    }
+  } while (true);
+  if (run(word_size, std::filesystem::path(Dataset::kData) / directory,
+          hard_mode, metric, mode, 0, 0, {})) {
     return EXIT_SUCCESS;
   } else {
     return EXIT_FAILURE;
@@ -0,0 +1,8 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Shen-Ta Hsieh
+
+#include "context.hpp"
+
+// every size and policy of the solver, the programs linking wordle_core only
+// declare them
+WORDLE_CONTEXT_INSTANCES()
@@ -3,14 +3,21 @@
 
 #include "context.hpp"
 #include "dataset.hpp"
+#include "history.hpp"
+#include "loader.hpp"
+#include "opening.hpp"
+#include "progress.hpp"
+#include "score.hpp"
 #include <SDL.h>
 #include <SDL_opengles2.h>
 #include <cinttypes>
+#include <codecvt>
 #include <cstdio>
 #include <future>
 #include <imgui.h>
 #include <imgui_impl_opengl3.h>
 #include <imgui_impl_sdl.h>
+#include <locale>
 #include <tbb/task_arena.h>
 #include <variant>
 #ifdef __EMSCRIPTEN__
@@ -119,26 +126,42 @@ bool g_Done = false;
 static std::variant<Context<4>, Context<5>, Context<6>, Context<7>, Context<8>,
                     Context<9>, Context<10>, Context<11>>
     g_Context(std::in_place_type<Context<5>>);
+static std::variant<Opening<4>, Opening<5>, Opening<6>, Opening<7>, Opening<8>,
+                    Opening<9>, Opening<10>, Opening<11>>
+    g_Opening(std::in_place_type<Opening<5>>);
+// turn of g_Context inside g_Opening, nullopt once the game left it
+static std::optional<uint32_t> g_OpeningKey;
+// metric of g_Opening
+static Score::Metric g_Metric = Score::Metric::kExcluded;
+
+template <size_t kSize> struct Turn {
+  typename Context<kSize>::Snapshot snapshot;
+  std::optional<uint32_t> key;
+};
+// a turn entered by a task, pushed by the ui thread which reads the history
+using AnyTurn = std::variant<Turn<4>, Turn<5>, Turn<6>, Turn<7>, Turn<8>,
+                             Turn<9>, Turn<10>, Turn<11>>;
+// turns entered into g_Context, for undo and redo
+static std::variant<History<Turn<4>>, History<Turn<5>>, History<Turn<6>>,
+                    History<Turn<7>>, History<Turn<8>>, History<Turn<9>>,
+                    History<Turn<10>>, History<Turn<11>>>
+    g_History(std::in_place_type<History<Turn<5>>>);
 
 template <size_t kSize>
-std::string load(const std::filesystem::path &directory,
-                 bool hard_mode) noexcept {
+std::string load(const std::filesystem::path &directory, bool hard_mode,
+                 Score::Metric metric) noexcept {
   auto &context = g_Context.emplace<Context<kSize>>();
-  if (auto set = Dataset::read<kSize>(Dataset::kData / directory /
-                                      Dataset::kPossible)) {
-    context.possible_answer = std::move(*set);
-  } else {
-    return "load possible failed";
+  auto loaded = Loader::load<kSize>(Dataset::kData / directory);
+  g_Opening.emplace<Opening<kSize>>(Loader::opening<kSize>(
+      loaded ? loaded->hash : std::nullopt, hard_mode, metric));
+  g_OpeningKey = Opening<kSize>::kFirst;
+  g_Metric = metric;
+  auto &history = g_History.emplace<History<Turn<kSize>>>();
+  if (!loaded) {
+    return "load dataset failed";
   }
-
-  if (auto set =
-          Dataset::read<kSize>(Dataset::kData / directory / Dataset::kValid)) {
-    context.valid_input = std::move(*set);
-  } else {
-    return "load valid failed";
-  }
-
-  context.reorder_all_word_set();
+  context = std::move(loaded->context);
+  history.reset({context.snapshot(), g_OpeningKey});
   return {};
 }
 
@@ -201,12 +224,22 @@ void main_loop(void) noexcept {
     static ImGuiTextBuffer message;
 
     static std::future<std::string> load_result;
-    static std::future<std::tuple<double, std::u32string>>
+    // std::nullopt once cancelled
+    static std::future<std::optional<std::tuple<double, std::u32string>>>
         best_candidate_result;
-    static std::future<std::tuple<uint64_t, uint64_t>> input_candidate_result;
-
-    ImGui::BeginDisabled(load_result.valid() || best_candidate_result.valid() ||
-                         input_candidate_result.valid());
+    static std::future<std::tuple<uint64_t, uint64_t, AnyTurn>>
+        input_candidate_result;
+    // ranked guesses and their descriptions
+    static std::future<std::vector<std::tuple<std::u32string, std::string>>>
+        top_candidates_result;
+    static std::vector<std::tuple<std::u32string, std::string>> top_candidates;
+    // of the running best candidate or top candidates search
+    static std::shared_ptr<Progress> progress;
+    const bool searching =
+        best_candidate_result.valid() || top_candidates_result.valid();
+
+    // a search is cancelled by loading another dataset
+    ImGui::BeginDisabled(load_result.valid() || input_candidate_result.valid());
     if (ImGui::BeginTable("Dataset", 2, ImGuiTableFlags_BordersInnerV)) {
       static int dataset = 4;
       static const std::array<const char *, 7> dataset_name{
@@ -217,6 +250,10 @@ void main_loop(void) noexcept {
       static const std::array<const char *, 8> word_size_name{
           "4", "5", "6", "7", "8", "9", "10", "11",
       };
+      static int metric = 0;
+      static const std::array<const char *, 4> metric_name{
+          "excluded", "entropy", "expected", "minimax",
+      };
 
       ImGui::TableNextColumn();
       ImGui::TextUnformatted("Dataset");
@@ -259,38 +296,68 @@ void main_loop(void) noexcept {
       ImGui::TableNextColumn();
       ImGui::Checkbox("##Hard mode", &hard_mode);
 
+      ImGui::TableNextColumn();
+      ImGui::TextUnformatted("Metric");
+      ImGui::TableNextColumn();
+      if (ImGui::BeginCombo("##Metric", metric_name[metric])) {
+        for (size_t i = 0; i < metric_name.size(); ++i) {
+          ImGui::PushID(i);
+          bool selected = (metric == i);
+          if (ImGui::Selectable(metric_name[i], selected)) {
+            metric = i;
+          }
+          if (selected) {
+            ImGui::SetItemDefaultFocus();
+          }
+          ImGui::PopID();
+        }
+        ImGui::EndCombo();
+      }
+
       ImGui::TableNextColumn();
       if (ImGui::Button("Load dataset")) {
+        if (searching) {
+          // the search reads g_Context, let it stop before the load
+          progress->cancel();
+          if (best_candidate_result.valid()) {
+            best_candidate_result.get();
+          }
+          if (top_candidates_result.valid()) {
+            top_candidates_result.get();
+          }
+        }
+        top_candidates.clear();
         auto promise = std::make_shared<std::promise<std::string>>();
         load_result = promise->get_future();
         tbb::this_task_arena::enqueue(
             [promise = std::move(promise), word_size = word_size_minus_4 + 4,
-             dataset = dataset_name[dataset]]() noexcept {
+             dataset = dataset_name[dataset],
+             metric = static_cast<Score::Metric>(metric)]() noexcept {
               std::string result;
               switch (word_size) {
               case 4:
-                result = load<4>(dataset, hard_mode);
+                result = load<4>(dataset, hard_mode, metric);
                 break;
               case 5:
-                result = load<5>(dataset, hard_mode);
+                result = load<5>(dataset, hard_mode, metric);
                 break;
               case 6:
-                result = load<6>(dataset, hard_mode);
+                result = load<6>(dataset, hard_mode, metric);
                 break;
               case 7:
-                result = load<7>(dataset, hard_mode);
+                result = load<7>(dataset, hard_mode, metric);
                 break;
               case 8:
-                result = load<8>(dataset, hard_mode);
+                result = load<8>(dataset, hard_mode, metric);
                 break;
               case 9:
-                result = load<9>(dataset, hard_mode);
+                result = load<9>(dataset, hard_mode, metric);
                 break;
               case 10:
-                result = load<10>(dataset, hard_mode);
+                result = load<10>(dataset, hard_mode, metric);
                 break;
               case 11:
-                result = load<11>(dataset, hard_mode);
+                result = load<11>(dataset, hard_mode, metric);
                 break;
               }
               promise->set_value(std::move(result));
@@ -299,27 +366,113 @@ void main_loop(void) noexcept {
 
       ImGui::EndTable();
     }
+    ImGui::EndDisabled();
 
     ImGui::Separator();
 
+    ImGui::BeginDisabled(load_result.valid() || searching ||
+                         input_candidate_result.valid());
     std::visit(
         [](auto &context) noexcept {
           ImGui::Text("Possible answers count: %zu",
                       load_result.valid() ? 0 : context.possible_answer.size());
+          // contradictory results can leave no answer to search for
+          ImGui::BeginDisabled(!load_result.valid() &&
+                               context.possible_answer.empty());
           if (ImGui::Button("Find best candidate")) {
-            auto promise = std::make_shared<
-                std::promise<std::tuple<double, std::u32string>>>();
+            auto promise = std::make_shared<std::promise<
+                std::optional<std::tuple<double, std::u32string>>>>();
             best_candidate_result = promise->get_future();
+            progress = std::make_shared<Progress>();
             tbb::this_task_arena::enqueue([promise = std::move(promise),
+                                           progress = progress,
                                            &context]() noexcept {
-              const auto [excluded, candidate] = context.find_best_candidate();
-              promise->set_value({excluded, std::u32string(candidate.begin(),
-                                                           candidate.end())});
+              constexpr const auto kSize =
+                  std::decay_t<decltype(context)>::size;
+              const auto best =
+                  std::get<Opening<kSize>>(g_Opening).find_best_candidate(
+                      context, g_OpeningKey, *progress);
+              if (!best) {
+                promise->set_value(std::nullopt);
+                return;
+              }
+              const auto &[score, candidate] = *best;
+              const auto word =
+                  context.alphabet.template decode<kSize>(candidate);
+              promise->set_value(
+                  std::tuple{score, std::u32string(word.begin(), word.end())});
             });
           }
+          ImGui::SameLine();
+          if (ImGui::Button("Rank top 10 candidates")) {
+            auto promise = std::make_shared<std::promise<
+                std::vector<std::tuple<std::u32string, std::string>>>>();
+            top_candidates_result = promise->get_future();
+            progress = std::make_shared<Progress>();
+            tbb::this_task_arena::enqueue([promise = std::move(promise),
+                                           progress = progress,
+                                           &context]() noexcept {
+              constexpr const auto kSize =
+                  std::decay_t<decltype(context)>::size;
+              std::vector<std::tuple<std::u32string, std::string>> ranked;
+              const auto candidates =
+                  context.find_top_candidates(10, g_Metric, *progress);
+              if (!candidates) {
+                // cancelled, nothing ranked
+                promise->set_value(std::move(ranked));
+                return;
+              }
+              for (const auto &candidate : *candidates) {
+                const auto word =
+                    context.alphabet.template decode<kSize>(candidate.word);
+                const auto metric_name = Score::name(g_Metric);
+                std::array<char, 160> text;
+                std::snprintf(text.data(), text.size(),
+                              "%s %.*s %lf, %zu buckets, largest %" PRIu32
+                              "%s",
+                              to_utf8<kSize>(word).c_str(),
+                              static_cast<int>(metric_name.size()),
+                              metric_name.data(), candidate.score,
+                              candidate.buckets.size(),
+                              candidate.buckets.empty()
+                                  ? UINT32_C(0)
+                                  : candidate.buckets.front(),
+                              candidate.possible ? ", possible answer" : "");
+                ranked.emplace_back(std::u32string(word.begin(), word.end()),
+                                    text.data());
+              }
+              promise->set_value(std::move(ranked));
+            });
+          }
+          ImGui::EndDisabled();
         },
         g_Context);
 
+    if (top_candidates_result.valid()) {
+      if (top_candidates_result.wait_for(std::chrono::seconds(0)) ==
+          std::future_status::ready) {
+        top_candidates = top_candidates_result.get();
+        if (top_candidates.empty()) {
+          message.clear();
+          message.append("Cancelled.");
+        }
+      }
+    }
+    if (!top_candidates.empty() &&
+        ImGui::BeginListBox("##Ranked", ImVec2(-FLT_MIN, 0))) {
+      for (const auto &[word_utf32, text] : top_candidates) {
+        // picking a ranked guess fills the input
+        if (ImGui::Selectable(text.c_str(), false)) {
+          const std::string word_utf8 = to_utf8(word_utf32);
+          std::copy(word_utf32.begin(), word_utf32.end() + 1,
+                    candidate_utf32.begin());
+          std::copy(word_utf8.begin(), word_utf8.end() + 1,
+                    candidate_utf8.begin());
+        }
+      }
+      ImGui::EndListBox();
+    }
+
     ImGui::Separator();
 
     if (ImGui::BeginTable("Input", 2, ImGuiTableFlags_BordersInnerV)) {
@@ -338,17 +491,24 @@ void main_loop(void) noexcept {
       if (best_candidate_result.valid()) {
         if (best_candidate_result.wait_for(std::chrono::seconds(0)) ==
             std::future_status::ready) {
-          const auto [best_excluded, best_candidate_utf32] =
-              best_candidate_result.get();
+          const auto best = best_candidate_result.get();
           message.clear();
-          std::string best_candidate_utf8 = to_utf8(best_candidate_utf32);
-          message.appendf("Best candidate: `%.*s` excluded %lf candidates",
-                          static_cast<int>(best_candidate_utf8.size()),
-                          best_candidate_utf8.data(), best_excluded);
-          std::copy(std::execution::unseq, best_candidate_utf32.begin(),
-                    best_candidate_utf32.end() + 1, candidate_utf32.begin());
-          std::copy(std::execution::unseq, best_candidate_utf8.begin(),
-                    best_candidate_utf8.end() + 1, candidate_utf8.begin());
+          if (best) {
+            const auto &[best_score, best_candidate_utf32] = *best;
+            std::string best_candidate_utf8 = to_utf8(best_candidate_utf32);
+            const auto metric_name = Score::name(g_Metric);
+            message.appendf("Best candidate: `%.*s` %.*s %lf",
+                            static_cast<int>(best_candidate_utf8.size()),
+                            best_candidate_utf8.data(),
+                            static_cast<int>(metric_name.size()),
+                            metric_name.data(), best_score);
+            std::copy(std::execution::unseq, best_candidate_utf32.begin(),
+                      best_candidate_utf32.end() + 1, candidate_utf32.begin());
+            std::copy(std::execution::unseq, best_candidate_utf8.begin(),
+                      best_candidate_utf8.end() + 1, candidate_utf8.begin());
+          } else {
+            message.append("Cancelled.");
+          }
         }
       }
 
@@ -381,6 +541,7 @@ void main_loop(void) noexcept {
 
       ImGui::TableNextColumn();
       if (ImGui::Button("Enter input and result")) {
+        top_candidates.clear();
         std::visit(
             [](auto &context) noexcept {
               constexpr const auto kSize =
@@ -393,27 +554,63 @@ void main_loop(void) noexcept {
                   message.append("Wrong candidate length!");
                   break;
                 }
-                std::array<char32_t, kSize> candidate;
-                std::copy_n(std::execution::unseq, candidate_utf32.begin(),
-                            kSize, candidate.begin());
+                const auto candidate =
+                    context.alphabet.template encode<kSize>(
+                        std::span<const char32_t, kSize>(
+                            candidate_utf32.data(), kSize));
                 candidate_utf8[0] = '\0';
                 std::fill_n(candidate_utf32.begin(), kSize, 0);
                 std::array<char8_t, kSize> parsed_result{};
                 std::copy_n(std::execution::unseq, result_value.begin(), kSize,
                             parsed_result.begin());
                 auto promise = std::make_shared<
-                    std::promise<std::tuple<uint64_t, uint64_t>>>();
+                    std::promise<std::tuple<uint64_t, uint64_t, AnyTurn>>>();
                 input_candidate_result = promise->get_future();
                 tbb::this_task_arena::enqueue([promise = std::move(promise),
                                                candidate, parsed_result,
                                                &context]() noexcept {
-                  promise->set_value(context.input_candidate(
-                      candidate, parsed_result, hard_mode));
+                  const auto [removed, remained] = context.input_candidate(
+                      candidate, parsed_result, hard_mode);
+                  const auto key = std::get<Opening<kSize>>(g_Opening).next(
+                      g_OpeningKey, candidate,
+                      Pattern::serialize<kSize>(parsed_result), hard_mode);
+                  promise->set_value({removed, remained,
+                                      Turn<kSize>{context.snapshot(), key}});
                 });
               } while (false);
             },
             g_Context);
       }
+      // snapshots are restored in place, no task needed. a loading task
+      // resets the history, so it is left alone until the task is done
+      if (!load_result.valid() && !input_candidate_result.valid()) {
+        std::visit(
+            [](auto &context) noexcept {
+              constexpr const auto kSize =
+                  std::decay_t<decltype(context)>::size;
+              auto &history = std::get<History<Turn<kSize>>>(g_History);
+              if (history.empty()) {
+                return;
+              }
+              ImGui::SameLine();
+              ImGui::BeginDisabled(!history.can_undo());
+              const bool undo = ImGui::Button("Undo");
+              ImGui::EndDisabled();
+              ImGui::SameLine();
+              ImGui::BeginDisabled(!history.can_redo());
+              const bool redo = ImGui::Button("Redo");
+              ImGui::EndDisabled();
+              if ((undo && history.undo()) || (redo && history.redo())) {
+                context.restore(history.current().snapshot);
+                g_OpeningKey = history.current().key;
+                top_candidates.clear();
+                message.clear();
+                message.appendf("%s, %zu candidates.", undo ? "Undo" : "Redo",
+                                context.possible_answer.size());
+              }
+            },
+            g_Context);
+      }
       ImGui::EndTable();
     }
 
@@ -428,7 +625,9 @@ void main_loop(void) noexcept {
               for (size_t i = 0;
                    i < std::min<size_t>(context.possible_answer.size(), 16);
                    ++i) {
-                const auto word = to_utf8<kSize>(context.possible_answer[i]);
+                const auto word = to_utf8<kSize>(
+                    context.alphabet.template decode<kSize>(
+                        context.possible_answer[i]));
                 ImGui::Selectable(word.c_str(), false);
               }
             },
@@ -438,6 +637,36 @@ void main_loop(void) noexcept {
     }
 
     ImGui::EndDisabled();
+    if (searching) {
+      ImGui::ProgressBar(static_cast<float>(progress->fraction()));
+      std::visit(
+          [](auto &context) noexcept {
+            constexpr const auto kSize = std::decay_t<decltype(context)>::size;
+            // valid_input stays put while it is searched
+            if (const auto best = progress->best()) {
+              const auto &[score, index] = *best;
+              const auto word_utf32 = context.alphabet.template decode<kSize>(
+                  context.valid_input[index]);
+              const auto word_utf8 = to_utf8<kSize>(word_utf32);
+              ImGui::Text("%.0f words/s, best so far `%s` %lf",
+                          progress->rate(), word_utf8.c_str(), score);
+              // the search refines it, but it is often good already
+              ImGui::SameLine();
+              if (ImGui::Button("Use")) {
+                *std::copy(word_utf32.begin(), word_utf32.end(),
+                           candidate_utf32.begin()) = 0;
+                std::copy(word_utf8.begin(), word_utf8.end() + 1,
+                          candidate_utf8.begin());
+              }
+            } else {
+              ImGui::Text("%.0f words/s", progress->rate());
+            }
+          },
+          g_Context);
+      if (ImGui::Button("Cancel")) {
+        progress->cancel();
+      }
+    }
     ImGui::TextUnformatted(message.begin(), message.end());
     ImGui::Text("Application average %.3f ms/frame (%.1f FPS)",
                 1000.0f / io.Framerate, io.Framerate);
@@ -455,8 +684,14 @@ void main_loop(void) noexcept {
     if (input_candidate_result.valid()) {
       if (input_candidate_result.wait_for(std::chrono::seconds(0)) ==
           std::future_status::ready) {
-        const auto [possible_answer_removed, possible_answer_remained] =
+        auto [possible_answer_removed, possible_answer_remained, turn] =
             input_candidate_result.get();
+        std::visit(
+            []<size_t kSize>(Turn<kSize> &turn) noexcept {
+              g_OpeningKey = turn.key;
+              std::get<History<Turn<kSize>>>(g_History).push(std::move(turn));
+            },
+            turn);
         message.clear();
         message.appendf("removed %" PRIu64 " candidates.",
                         possible_answer_removed);
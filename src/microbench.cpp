@@ -0,0 +1,314 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Shen-Ta Hsieh
+
+#include "context.hpp"
+#include "dataset.hpp"
+#include "score.hpp"
+#include <benchmark/benchmark.h>
+#include <codecvt>
+#include <fstream>
+#include <locale>
+#include <map>
+#include <string>
+#include <vector>
+
+using std::literals::string_view_literals::operator""sv;
+
+namespace {
+
+// answers kept per dataset for the guess x answer benchmarks, so the
+// largest datasets still finish an iteration in reasonable time
+static inline constexpr const std::size_t kAnswerLimit = 1024;
+
+template <std::size_t kSize>
+const Context<kSize> *load(std::string_view dataset) noexcept {
+  static std::map<std::string, std::optional<Context<kSize>>, std::less<>>
+      contexts;
+  if (auto it = contexts.find(dataset); it != contexts.end()) {
+    return it->second ? &*it->second : nullptr;
+  }
+  auto &context = contexts[std::string(dataset)];
+  const auto directory = std::filesystem::path(Dataset::kData) / dataset;
+  if (auto words = Dataset::load<kSize>(directory)) {
+    context.emplace();
+    context->alphabet = std::move(words->alphabet);
+    context->possible_answer = std::move(words->possible);
+    context->valid_input = std::move(words->valid);
+  }
+  return context ? &*context : nullptr;
+}
+
+// evenly spread subset of the answers
+template <std::size_t kSize>
+Context<kSize> sample(const Context<kSize> &context) noexcept {
+  Context<kSize> result = context;
+  const auto &answers = context.possible_answer;
+  if (answers.size() > kAnswerLimit) {
+    size_t next = 0;
+    result.possible_answer.filter([&answers, &next](size_t position) noexcept {
+      if (next == kAnswerLimit ||
+          position != next * answers.size() / kAnswerLimit) {
+        return false;
+      }
+      ++next;
+      return true;
+    });
+  }
+  return result;
+}
+
+template <std::size_t kSize>
+void calculate(benchmark::State &state, std::string_view dataset) noexcept {
+  const auto *context = load<kSize>(dataset);
+  if (!context) {
+    state.SkipWithError("load dataset failed");
+    return;
+  }
+  const auto &words = context->possible_answer;
+  for (auto _ : state) {
+    for (const auto &word : words) {
+      for (const auto &answer : words) {
+        benchmark::DoNotOptimize(Context<kSize>::calculate(word, answer));
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * words.size() * words.size());
+  state.SetLabel("pairs");
+}
+
+template <std::size_t kSize>
+void kernel(benchmark::State &state, std::string_view dataset) noexcept {
+  const auto *context = load<kSize>(dataset);
+  if (!context) {
+    state.SkipWithError("load dataset failed");
+    return;
+  }
+  const auto &words = context->possible_answer;
+  const Pattern::Columns<kSize> columns(words.words(), words.indexes());
+  std::vector<Pattern::type<kSize>> patterns(words.size());
+  for (auto _ : state) {
+    for (const auto &word : words) {
+      Pattern::calculate<kSize>(word, columns, 0, patterns);
+      benchmark::DoNotOptimize(patterns.data());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * words.size() * words.size());
+  state.SetLabel("pairs");
+}
+
+template <std::size_t kSize>
+void find_best_candidate(benchmark::State &state, std::string_view dataset,
+                         Score::Metric metric) noexcept {
+  const auto *context = load<kSize>(dataset);
+  if (!context) {
+    state.SkipWithError("load dataset failed");
+    return;
+  }
+  const auto sampled = sample(*context);
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(sampled.find_best_candidate(metric));
+  }
+  state.SetItemsProcessed(state.iterations() * sampled.valid_input.size() *
+                          sampled.possible_answer.size());
+  state.SetLabel("pairs");
+}
+
+template <std::size_t kSize>
+void input_candidate(benchmark::State &state, std::string_view dataset,
+                     bool hard_mode) noexcept {
+  const auto *context = load<kSize>(dataset);
+  if (!context) {
+    state.SkipWithError("load dataset failed");
+    return;
+  }
+  const auto &guess = context->valid_input.front();
+  const auto result = Context<kSize>::calculate(
+      guess, context->possible_answer[context->possible_answer.size() / 2]);
+  for (auto _ : state) {
+    state.PauseTiming();
+    auto copy = *context;
+    state.ResumeTiming();
+    benchmark::DoNotOptimize(copy.input_candidate(guess, result, hard_mode));
+  }
+  state.SetItemsProcessed(
+      state.iterations() *
+      (context->possible_answer.size() +
+       (hard_mode ? context->valid_input.size() : 0)));
+  state.SetLabel("words");
+}
+
+template <std::size_t kSize>
+void read(benchmark::State &state, std::string_view dataset) noexcept {
+  const auto directory = std::filesystem::path(Dataset::kData) / dataset;
+  std::size_t words = 0;
+  for (auto _ : state) {
+    const auto result = Dataset::read<kSize>(directory / Dataset::kPossible,
+                                             directory / Dataset::kValid);
+    if (!result) {
+      state.SkipWithError("load dataset failed");
+      return;
+    }
+    words = result->possible.size() + result->valid.size();
+  }
+  state.SetItemsProcessed(state.iterations() * words);
+  state.SetLabel("words");
+}
+
+template <std::size_t kSize>
+void read_packed(benchmark::State &state, std::string_view dataset) noexcept {
+  const auto directory = std::filesystem::path(Dataset::kData) / dataset;
+  const auto words = Dataset::read<kSize>(directory / Dataset::kPossible,
+                                          directory / Dataset::kValid);
+  std::error_code error;
+  const auto filename =
+      std::filesystem::temp_directory_path(error) /
+      ("wordle_solver_microbench-" + std::string(dataset) + ".bin");
+  if (!words || error || !Dataset::write_packed<kSize>(filename, *words)) {
+    state.SkipWithError("pack dataset failed");
+    return;
+  }
+  for (auto _ : state) {
+    const auto result = Dataset::read_packed<kSize>(filename);
+    if (!result) {
+      state.SkipWithError("read packed dataset failed");
+      break;
+    }
+    benchmark::DoNotOptimize(result->valid.words().data());
+  }
+  state.SetBytesProcessed(state.iterations() *
+                          std::filesystem::file_size(filename, error));
+  std::filesystem::remove(filename, error);
+}
+
+// the getline and wstring_convert reader Dataset::read replaced, kept to
+// compare load times
+template <std::size_t kSize>
+std::optional<std::vector<std::array<char32_t, kSize>>>
+read_getline(const std::filesystem::path &filename) noexcept {
+  std::ifstream file(filename);
+  if (!file) {
+    return std::nullopt;
+  }
+  std::wstring_convert<std::codecvt_utf8_utf16<char32_t>, char32_t> converter;
+  std::vector<std::array<char32_t, kSize>> list;
+  std::string line;
+  while (std::getline(file, line)) {
+    const auto line_utf32 = converter.from_bytes(line);
+    if (line_utf32.size() != kSize) {
+      continue;
+    }
+    std::array<char32_t, kSize> word;
+    std::copy(line_utf32.begin(), line_utf32.end(), word.begin());
+    list.push_back(word);
+  }
+  std::sort(std::execution::par_unseq, list.begin(), list.end());
+  list.erase(std::unique(std::execution::par_unseq, list.begin(), list.end()),
+             list.end());
+  list.shrink_to_fit();
+  return list;
+}
+
+// both word lists of a dataset, without building the alphabet
+template <std::size_t kSize>
+void read_words(benchmark::State &state, std::string_view dataset,
+                bool getline) noexcept {
+  const auto directory = std::filesystem::path(Dataset::kData) / dataset;
+  const auto reader = [getline](const std::filesystem::path &filename) {
+    return getline ? read_getline<kSize>(filename)
+                   : Dataset::read<kSize>(filename);
+  };
+  std::size_t bytes = 0;
+  for (const auto name : {Dataset::kPossible, Dataset::kValid}) {
+    bytes += std::filesystem::file_size(directory / name);
+  }
+  for (auto _ : state) {
+    for (const auto name : {Dataset::kPossible, Dataset::kValid}) {
+      const auto words = reader(directory / name);
+      if (!words) {
+        state.SkipWithError("read words failed");
+        return;
+      }
+      benchmark::DoNotOptimize(words->data());
+    }
+  }
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+
+template <std::size_t kSize> void register_dataset(std::string_view dataset) {
+  const std::string suffix = "/" + std::string(dataset);
+  for (size_t index = 0; index < Score::kNames.size(); ++index) {
+    const auto metric = static_cast<Score::Metric>(index);
+    // the default metric keeps the plain name to compare with older results
+    std::string name = "find_best_candidate" + suffix;
+    if (metric != Score::Metric::kExcluded) {
+      name += '/';
+      name += Score::kNames[index];
+    }
+    benchmark::RegisterBenchmark(name.c_str(), find_best_candidate<kSize>,
+                                 dataset, metric)
+        ->Unit(benchmark::kMillisecond)
+        ->UseRealTime();
+  }
+  benchmark::RegisterBenchmark(("input_candidate" + suffix).c_str(),
+                               input_candidate<kSize>, dataset, false)
+      ->Unit(benchmark::kMicrosecond)
+      ->UseRealTime();
+  benchmark::RegisterBenchmark(("input_candidate" + suffix + "/hard").c_str(),
+                               input_candidate<kSize>, dataset, true)
+      ->Unit(benchmark::kMicrosecond)
+      ->UseRealTime();
+  benchmark::RegisterBenchmark(("Dataset::read" + suffix).c_str(),
+                               read<kSize>, dataset)
+      ->Unit(benchmark::kMillisecond);
+  benchmark::RegisterBenchmark(("Dataset::read_packed" + suffix).c_str(),
+                               read_packed<kSize>, dataset)
+      ->Unit(benchmark::kMillisecond);
+  benchmark::RegisterBenchmark(("read_words" + suffix).c_str(),
+                               read_words<kSize>, dataset, false)
+      ->Unit(benchmark::kMillisecond);
+  benchmark::RegisterBenchmark(("read_words" + suffix + "/getline").c_str(),
+                               read_words<kSize>, dataset, true)
+      ->Unit(benchmark::kMillisecond);
+}
+
+template <std::size_t kSize> void register_size() {
+  // wordlegame is the only dataset holding every word size
+  const std::string suffix = "/wordlegame/" + std::to_string(kSize);
+  benchmark::RegisterBenchmark(("Context::calculate" + suffix).c_str(),
+                               calculate<kSize>, "wordlegame"sv)
+      ->Unit(benchmark::kMillisecond);
+  benchmark::RegisterBenchmark(("Pattern::calculate" + suffix).c_str(),
+                               kernel<kSize>, "wordlegame"sv)
+      ->Unit(benchmark::kMillisecond);
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  register_size<4>();
+  register_size<5>();
+  register_size<6>();
+  register_size<7>();
+  register_size<8>();
+  register_size<9>();
+  register_size<10>();
+  register_size<11>();
+  register_dataset<5>("wordle"sv);
+  register_dataset<8>("nerdlegame"sv);
+  register_dataset<5>("bopomofo"sv);
+  register_dataset<4>("japanese"sv);
+
+  // json by default so results can be compared across commits, a later
+  // --benchmark_format flag still wins
+  std::string format = "--benchmark_format=json";
+  std::vector<char *> arguments(argv, argv + argc);
+  arguments.insert(arguments.begin() + 1, format.data());
+  int count = static_cast<int>(arguments.size());
+  benchmark::Initialize(&count, arguments.data());
+  if (benchmark::ReportUnrecognizedArguments(count, arguments.data())) {
+    return EXIT_FAILURE;
+  }
+  benchmark::RunSpecifiedBenchmarks();
+  benchmark::Shutdown();
+  return EXIT_SUCCESS;
+}
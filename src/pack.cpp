@@ -0,0 +1,138 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Shen-Ta Hsieh
+
+#include "dataset.hpp"
+#include <charconv>
+#include <cstdlib>
+#include <filesystem>
+#include <optional>
+#include <spdlog/spdlog.h>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+using std::literals::string_view_literals::operator""sv;
+
+namespace {
+
+struct Options {
+  // every size when unset
+  std::optional<std::size_t> word_size;
+  std::vector<std::filesystem::path> directories;
+};
+
+inline constexpr const auto kUsage =
+    "usage: wordle_dataset_pack [--size 4~11] directory..."sv;
+
+// pack the words of kSize in directory, sizes without words are skipped
+template <std::size_t kSize>
+bool pack(const std::filesystem::path &directory) noexcept {
+  const auto words = Dataset::read<kSize>(directory / Dataset::kPossible,
+                                          directory / Dataset::kValid);
+  if (!words) {
+    spdlog::error("read dataset `{}` failed"sv, directory.string());
+    return false;
+  }
+  if (words->valid.empty()) {
+    return true;
+  }
+  const auto filename = Dataset::packed<kSize>(directory);
+  if (!Dataset::write_packed<kSize>(filename, *words)) {
+    spdlog::error("write `{}` failed"sv, filename.string());
+    return false;
+  }
+  std::error_code error;
+  const auto bytes = std::filesystem::file_size(filename, error);
+  spdlog::info("packed `{}`, {} words, {} answers, {} symbols, {} bytes"sv,
+               filename.string(), words->valid.size(), words->possible.size(),
+               words->alphabet.symbols.size(), error ? 0 : bytes);
+  return true;
+}
+
+bool pack(std::size_t word_size,
+          const std::filesystem::path &directory) noexcept {
+  switch (word_size) {
+  default:
+    spdlog::error("unsupported size `{}`! need 4~11"sv, word_size);
+    return false;
+  case 4:
+    return pack<4>(directory);
+  case 5:
+    return pack<5>(directory);
+  case 6:
+    return pack<6>(directory);
+  case 7:
+    return pack<7>(directory);
+  case 8:
+    return pack<8>(directory);
+  case 9:
+    return pack<9>(directory);
+  case 10:
+    return pack<10>(directory);
+  case 11:
+    return pack<11>(directory);
+  }
+}
+
+std::optional<std::size_t> parse_number(std::string_view text) noexcept {
+  std::size_t value;
+  const auto [last, error] =
+      std::from_chars(text.data(), text.data() + text.size(), value);
+  if (error != std::errc() || last != text.data() + text.size()) {
+    return std::nullopt;
+  }
+  return value;
+}
+
+std::optional<Options> parse_options(int argc, char *argv[]) noexcept {
+  Options options;
+  for (int index = 1; index < argc; ++index) {
+    const std::string_view flag = argv[index];
+    if (!flag.starts_with("--"sv)) {
+      options.directories.emplace_back(flag);
+      continue;
+    }
+    if (index + 1 == argc) {
+      spdlog::error("missing value of `{}`"sv, flag);
+      return std::nullopt;
+    }
+    const std::string_view value = argv[++index];
+    if (flag == "--size"sv) {
+      if (const auto size = parse_number(value)) {
+        options.word_size = *size;
+        continue;
+      }
+    } else {
+      spdlog::error("unknown flag `{}`"sv, flag);
+      return std::nullopt;
+    }
+    spdlog::error("invalid value `{}` of `{}`"sv, value, flag);
+    return std::nullopt;
+  }
+  if (options.directories.empty()) {
+    spdlog::error("no dataset directory"sv);
+    return std::nullopt;
+  }
+  return options;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) noexcept {
+  const auto options = parse_options(argc, argv);
+  if (!options) {
+    spdlog::info("{}"sv, kUsage);
+    return EXIT_FAILURE;
+  }
+  bool success = true;
+  for (const auto &directory : options->directories) {
+    if (options->word_size) {
+      success = pack(*options->word_size, directory) && success;
+      continue;
+    }
+    for (std::size_t word_size = 4; word_size <= 11; ++word_size) {
+      success = pack(word_size, directory) && success;
+    }
+  }
+  return success ? EXIT_SUCCESS : EXIT_FAILURE;
+}
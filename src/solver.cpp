@@ -0,0 +1,318 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Shen-Ta Hsieh
+
+#include "solver.hpp"
+#include "context.hpp"
+#include "dataset.hpp"
+#include "history.hpp"
+#include "loader.hpp"
+#include <algorithm>
+#include <array>
+#include <span>
+
+namespace {
+
+template <std::size_t kSize>
+std::string to_utf8(std::span<const char32_t, kSize> word) noexcept {
+  std::string result;
+  result.reserve(kSize);
+  for (const auto code : word) {
+    if (code < 0x80) {
+      result += static_cast<char>(code);
+      continue;
+    }
+    // continuation bytes after the lead one, 6 bits each
+    const int tail = code < 0x800 ? 1 : code < 0x10000 ? 2 : 3;
+    constexpr const std::array<uint8_t, 4> kLead{0, 0xc0, 0xe0, 0xf0};
+    result += static_cast<char>(kLead[tail] | (code >> (6 * tail)));
+    for (int shift = 6 * (tail - 1); shift >= 0; shift -= 6) {
+      result += static_cast<char>(0x80 | ((code >> shift) & 0x3f));
+    }
+  }
+  return result;
+}
+
+template <std::size_t kSize>
+std::optional<std::array<char8_t, kSize>>
+parse_pattern(std::string_view text) noexcept {
+  if (text.size() != kSize) {
+    return std::nullopt;
+  }
+  std::array<char8_t, kSize> result;
+  for (size_t index = 0; index < kSize; ++index) {
+    if (text[index] < '0' || text[index] > '2') {
+      return std::nullopt;
+    }
+    result[index] = static_cast<char8_t>(text[index] - '0');
+  }
+  return result;
+}
+
+} // namespace
+
+class Solver::Game {
+public:
+  virtual ~Game() = default;
+
+  virtual std::unique_ptr<Game> clone() const noexcept = 0;
+  virtual std::size_t size() const noexcept = 0;
+  virtual std::size_t remaining() const noexcept = 0;
+  virtual std::vector<std::string> answers() const noexcept = 0;
+  virtual std::optional<std::string>
+  answer(std::size_t index) const noexcept = 0;
+  virtual std::optional<Guess>
+  best_guess(Score::Metric metric) const noexcept = 0;
+  virtual std::vector<Candidate>
+  top_guesses(std::size_t count, Score::Metric metric) const noexcept = 0;
+  virtual std::optional<Guess>
+  lookahead_guess(std::size_t depth, std::size_t width,
+                  Score::Metric metric) const noexcept = 0;
+  virtual bool input(std::string_view guess, std::string_view pattern,
+                     bool hard_mode) noexcept = 0;
+  virtual std::optional<std::string>
+  pattern(std::string_view guess, std::string_view answer) const noexcept = 0;
+  virtual bool undo() noexcept = 0;
+  virtual bool redo() noexcept = 0;
+  virtual void reset() noexcept = 0;
+};
+
+template <std::size_t kSize> class Solver::Instance final : public Game {
+public:
+  using Snapshot = typename Context<kSize>::Snapshot;
+
+  explicit Instance(Context<kSize> context) noexcept
+      : context(std::move(context)), initial(this->context.snapshot()),
+        history(initial) {}
+
+  static std::unique_ptr<Game>
+  load(const std::filesystem::path &directory) noexcept {
+    auto loaded = Loader::load<kSize>(directory);
+    if (!loaded) {
+      return nullptr;
+    }
+    return std::make_unique<Instance>(std::move(loaded->context));
+  }
+
+  std::unique_ptr<Game> clone() const noexcept override {
+    return std::make_unique<Instance>(*this);
+  }
+
+  std::size_t size() const noexcept override { return kSize; }
+
+  std::size_t remaining() const noexcept override {
+    return context.possible_answer.size();
+  }
+
+  std::vector<std::string> answers() const noexcept override {
+    std::vector<std::string> result;
+    result.reserve(context.possible_answer.size());
+    for (const auto &answer : context.possible_answer) {
+      result.push_back(word(answer));
+    }
+    return result;
+  }
+
+  std::optional<std::string>
+  answer(std::size_t index) const noexcept override {
+    if (index >= context.possible_answer.size()) {
+      return std::nullopt;
+    }
+    return word(context.possible_answer[index]);
+  }
+
+  std::optional<Guess>
+  best_guess(Score::Metric metric) const noexcept override {
+    if (context.possible_answer.empty()) {
+      return std::nullopt;
+    }
+    const auto [score, best] = context.find_best_candidate(metric);
+    return Guess{word(best), score};
+  }
+
+  std::vector<Candidate>
+  top_guesses(std::size_t count, Score::Metric metric) const noexcept override {
+    if (context.possible_answer.empty()) {
+      return {};
+    }
+    const auto candidates = context.find_top_candidates(count, metric);
+    std::vector<Candidate> result;
+    result.reserve(candidates.size());
+    for (const auto &candidate : candidates) {
+      result.push_back({word(candidate.word), candidate.score,
+                        candidate.possible, candidate.buckets});
+    }
+    return result;
+  }
+
+  std::optional<Guess>
+  lookahead_guess(std::size_t depth, std::size_t width,
+                  Score::Metric metric) const noexcept override {
+    if (context.possible_answer.empty()) {
+      return std::nullopt;
+    }
+    const auto [expected, best] = context.find_lookahead_candidate(
+        std::max<std::size_t>(depth, 1), std::max<std::size_t>(width, 1),
+        metric);
+    return Guess{word(best), expected};
+  }
+
+  bool input(std::string_view guess, std::string_view pattern,
+             bool hard_mode) noexcept override {
+    std::array<char32_t, kSize> chars;
+    const auto result = parse_pattern<kSize>(pattern);
+    if (!result || !Dataset::decode<kSize>(guess, chars)) {
+      return false;
+    }
+    const auto symbols = context.alphabet.template encode<kSize>(chars);
+    context.input_candidate(symbols, *result, hard_mode);
+    history.push(context.snapshot());
+    return true;
+  }
+
+  std::optional<std::string>
+  pattern(std::string_view guess,
+          std::string_view answer) const noexcept override {
+    std::array<char32_t, kSize> guess_chars;
+    std::array<char32_t, kSize> answer_chars;
+    if (!Dataset::decode<kSize>(guess, guess_chars) ||
+        !Dataset::decode<kSize>(answer, answer_chars)) {
+      return std::nullopt;
+    }
+    const auto answer_symbols =
+        context.alphabet.template encode<kSize>(answer_chars);
+    // letters outside the alphabet are all one unknown symbol, grey in a
+    // guess but matching each other were the answer to have any
+    if (std::find(answer_symbols.begin(), answer_symbols.end(),
+                  Alphabet::kUnknown) != answer_symbols.end()) {
+      return std::nullopt;
+    }
+    const auto result = Context<kSize>::calculate(
+        context.alphabet.template encode<kSize>(guess_chars), answer_symbols);
+    std::string text(kSize, '0');
+    std::transform(result.begin(), result.end(), text.begin(),
+                   [](char8_t digit) noexcept {
+                     return static_cast<char>('0' + digit);
+                   });
+    return text;
+  }
+
+  bool undo() noexcept override {
+    if (!history.undo()) {
+      return false;
+    }
+    context.restore(history.current());
+    return true;
+  }
+
+  bool redo() noexcept override {
+    if (!history.redo()) {
+      return false;
+    }
+    context.restore(history.current());
+    return true;
+  }
+
+  void reset() noexcept override {
+    history.reset(initial);
+    context.restore(initial);
+  }
+
+private:
+  std::string word(
+      std::span<const Alphabet::symbol_type, kSize> symbols) const noexcept {
+    return to_utf8<kSize>(context.alphabet.template decode<kSize>(symbols));
+  }
+
+  Context<kSize> context;
+  Snapshot initial;
+  History<Snapshot> history;
+};
+
+std::optional<Solver> Solver::load(const std::filesystem::path &directory,
+                                   std::size_t size) noexcept {
+  std::unique_ptr<Game> game;
+  switch (size) {
+  case 4:
+    game = Instance<4>::load(directory);
+    break;
+  case 5:
+    game = Instance<5>::load(directory);
+    break;
+  case 6:
+    game = Instance<6>::load(directory);
+    break;
+  case 7:
+    game = Instance<7>::load(directory);
+    break;
+  case 8:
+    game = Instance<8>::load(directory);
+    break;
+  case 9:
+    game = Instance<9>::load(directory);
+    break;
+  case 10:
+    game = Instance<10>::load(directory);
+    break;
+  case 11:
+    game = Instance<11>::load(directory);
+    break;
+  }
+  if (!game) {
+    return std::nullopt;
+  }
+  return Solver(std::move(game));
+}
+
+Solver::Solver(std::unique_ptr<Game> game) noexcept : game(std::move(game)) {}
+Solver::Solver(Solver &&) noexcept = default;
+Solver &Solver::operator=(Solver &&) noexcept = default;
+Solver::~Solver() = default;
+
+Solver Solver::clone() const noexcept { return Solver(game->clone()); }
+
+std::size_t Solver::size() const noexcept { return game->size(); }
+
+std::size_t Solver::remaining() const noexcept { return game->remaining(); }
+
+bool Solver::is_finished() const noexcept { return remaining() <= 1; }
+
+std::vector<std::string> Solver::answers() const noexcept {
+  return game->answers();
+}
+
+std::optional<std::string> Solver::answer(std::size_t index) const noexcept {
+  return game->answer(index);
+}
+
+std::optional<Solver::Guess>
+Solver::best_guess(Score::Metric metric) const noexcept {
+  return game->best_guess(metric);
+}
+
+std::vector<Solver::Candidate>
+Solver::top_guesses(std::size_t count, Score::Metric metric) const noexcept {
+  return game->top_guesses(count, metric);
+}
+
+std::optional<Solver::Guess>
+Solver::lookahead_guess(std::size_t depth, std::size_t width,
+                        Score::Metric metric) const noexcept {
+  return game->lookahead_guess(depth, width, metric);
+}
+
+bool Solver::input(std::string_view guess, std::string_view pattern,
+                   bool hard_mode) noexcept {
+  return game->input(guess, pattern, hard_mode);
+}
+
+std::optional<std::string>
+Solver::pattern(std::string_view guess,
+                std::string_view answer) const noexcept {
+  return game->pattern(guess, answer);
+}
+
+bool Solver::undo() noexcept { return game->undo(); }
+
+bool Solver::redo() noexcept { return game->redo(); }
+
+void Solver::reset() noexcept { game->reset(); }
@@ -0,0 +1,127 @@
+// SPDX-License-Identifier: MIT
+// SPDX-FileCopyrightText: 2022 Shen-Ta Hsieh
+
+#include "wordle.h"
+#include "solver.hpp"
+#include <cstring>
+#include <mutex>
+#include <new>
+#include <string>
+
+struct wordle_game {
+  explicit wordle_game(Solver solver) noexcept : solver(std::move(solver)) {}
+
+  mutable std::mutex mutex;
+  Solver solver;
+};
+
+namespace {
+
+// text and its terminator into buffer
+wordle_status copy(const std::string &text, char *buffer,
+                   size_t capacity) noexcept {
+  if (!buffer || text.size() >= capacity) {
+    return WORDLE_TOO_SMALL;
+  }
+  std::memcpy(buffer, text.data(), text.size());
+  buffer[text.size()] = '\0';
+  return WORDLE_OK;
+}
+
+} // namespace
+
+wordle_game *wordle_open_dataset(const char *directory, size_t size) {
+  if (!directory) {
+    return nullptr;
+  }
+  auto solver = Solver::load(directory, size);
+  if (!solver) {
+    return nullptr;
+  }
+  return new (std::nothrow) wordle_game(std::move(*solver));
+}
+
+wordle_game *wordle_clone(const wordle_game *game) {
+  if (!game) {
+    return nullptr;
+  }
+  const std::lock_guard lock(game->mutex);
+  return new (std::nothrow) wordle_game(game->solver.clone());
+}
+
+void wordle_free(wordle_game *game) { delete game; }
+
+size_t wordle_word_size(const wordle_game *game) {
+  return game ? game->solver.size() : 0;
+}
+
+size_t wordle_remaining(const wordle_game *game) {
+  if (!game) {
+    return 0;
+  }
+  const std::lock_guard lock(game->mutex);
+  return game->solver.remaining();
+}
+
+wordle_status wordle_answer(const wordle_game *game, size_t index, char *word,
+                            size_t capacity) {
+  if (!game) {
+    return WORDLE_INVALID;
+  }
+  const std::lock_guard lock(game->mutex);
+  const auto answer = game->solver.answer(index);
+  if (!answer) {
+    return WORDLE_INVALID;
+  }
+  return copy(*answer, word, capacity);
+}
+
+wordle_status wordle_best_guess(const wordle_game *game, wordle_metric metric,
+                                char *word, size_t capacity, double *score) {
+  if (!game || static_cast<unsigned>(metric) > WORDLE_MINIMAX) {
+    return WORDLE_INVALID;
+  }
+  const std::lock_guard lock(game->mutex);
+  const auto guess =
+      game->solver.best_guess(static_cast<Score::Metric>(metric));
+  if (!guess) {
+    return WORDLE_NO_ANSWER;
+  }
+  const auto status = copy(guess->word, word, capacity);
+  if (status == WORDLE_OK && score) {
+    *score = guess->score;
+  }
+  return status;
+}
+
+wordle_status wordle_apply_feedback(wordle_game *game, const char *guess,
+                                    const char *pattern, int hard_mode) {
+  if (!game || !guess || !pattern) {
+    return WORDLE_INVALID;
+  }
+  const std::lock_guard lock(game->mutex);
+  return game->solver.input(guess, pattern, hard_mode != 0) ? WORDLE_OK
+                                                            : WORDLE_INVALID;
+}
+
+wordle_status wordle_pattern(const wordle_game *game, const char *guess,
+                             const char *answer, char *pattern,
+                             size_t capacity) {
+  if (!game || !guess || !answer) {
+    return WORDLE_INVALID;
+  }
+  const std::lock_guard lock(game->mutex);
+  const auto result = game->solver.pattern(guess, answer);
+  if (!result) {
+    return WORDLE_INVALID;
+  }
+  return copy(*result, pattern, capacity);
+}
+
+void wordle_reset(wordle_game *game) {
+  if (!game) {
+    return;
+  }
+  const std::lock_guard lock(game->mutex);
+  game->solver.reset();
+}